@@ -0,0 +1,358 @@
+// Microbenchmarks for the request hot path: parsing, routing, response
+// serialization, thread pool dispatch and form body parsing.
+//
+// Usage: cppweb_bench [--filter SUBSTRING] [--min-time SECONDS]
+
+#include "../include/cppweb.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+
+namespace {
+
+template<typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchOptions {
+    std::string filter;
+    double min_time = 0.5;
+};
+
+struct BenchResult {
+    uint64_t iterations = 0;
+    double seconds = 0;
+};
+
+// Runs body(batch) with growing batch sizes until min_time is covered, then
+// reports the per-operation cost of the final batch.
+BenchResult run_batches(double min_time, const std::function<void(uint64_t)>& body) {
+    using clock = std::chrono::steady_clock;
+    uint64_t batch = 1;
+    while (true) {
+        auto start = clock::now();
+        body(batch);
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (elapsed >= min_time || batch >= (uint64_t(1) << 40)) {
+            return {batch, elapsed};
+        }
+        double scale = elapsed > 0 ? min_time / elapsed * 1.2 : 10.0;
+        batch = static_cast<uint64_t>(static_cast<double>(batch) * std::min(std::max(scale, 1.5), 10.0));
+    }
+}
+
+void report(const std::string& name, const BenchResult& result, uint64_t ops_per_iteration = 1) {
+    double ops = static_cast<double>(result.iterations * ops_per_iteration);
+    double ns_per_op = result.seconds * 1e9 / ops;
+    std::cout << std::left << std::setw(44) << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(1) << ns_per_op << " ns/op"
+              << std::setw(14) << std::setprecision(0) << ops / result.seconds << " ops/s\n";
+}
+
+bool selected(const BenchOptions& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// --- parse_request ---------------------------------------------------------
+
+void bench_parse(const BenchOptions& options) {
+    const std::string small =
+        "GET /api/status HTTP/1.1\r\n"
+        "Host: localhost:8080\r\n"
+        "User-Agent: cppweb-bench\r\n"
+        "Accept: */*\r\n\r\n";
+
+    std::string browser =
+        "GET /search?q=libcppweb&page=2&sort=desc&lang=en HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; tz=Europe/Berlin\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n\r\n";
+
+    std::string post = "POST /api/echo HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\nContent-Length: 4096\r\n\r\n";
+    post.append(4096, 'x');
+
+    struct Case { const char* name; const std::string* raw; };
+    const Case cases[] = {
+        {"parse_request/small_get", &small},
+        {"parse_request/browser_get", &browser},
+        {"parse_request/post_4k_body", &post},
+    };
+
+    for (const auto& c : cases) {
+        if (!selected(options, c.name)) continue;
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                cppweb::Request req = cppweb::utils::parse_request(*c.raw);
+                do_not_optimize(req);
+            }
+        });
+        report(c.name, result);
+    }
+}
+
+// --- Router::route ---------------------------------------------------------
+
+void bench_route(const BenchOptions& options) {
+    for (size_t route_count : {10, 1000, 10000}) {
+        std::string name = "router/route_hit/" + std::to_string(route_count);
+        std::string miss_name = "router/route_miss/" + std::to_string(route_count);
+        if (!selected(options, name) && !selected(options, miss_name)) continue;
+
+        cppweb::Router router;
+        std::vector<cppweb::Request> requests;
+        for (size_t i = 0; i < route_count; ++i) {
+            std::string path = "/api/v1/resource" + std::to_string(i) + "/items";
+            router.get(path, [](const cppweb::Request&, cppweb::Response& res) {
+                res.status_code = 200;
+            });
+            if (requests.size() < 1024) {
+                cppweb::Request req;
+                req.method = "GET";
+                req.path = path;
+                requests.push_back(std::move(req));
+            }
+        }
+        std::shuffle(requests.begin(), requests.end(), std::mt19937(42));
+
+        if (selected(options, name)) {
+            BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    cppweb::Response res;
+                    bool matched = router.route(requests[i % requests.size()], res);
+                    do_not_optimize(matched);
+                }
+            });
+            report(name, result);
+        }
+
+        if (selected(options, miss_name)) {
+            cppweb::Request miss;
+            miss.method = "GET";
+            miss.path = "/api/v1/does-not-exist";
+            BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    cppweb::Response res;
+                    bool matched = router.route(miss, res);
+                    do_not_optimize(matched);
+                }
+            });
+            report(miss_name, result);
+        }
+    }
+}
+
+// --- Response serialization ------------------------------------------------
+
+void bench_serialize(const BenchOptions& options) {
+    cppweb::Response small;
+    small.content_type = "application/json";
+    small.body = R"({"status": "ok", "version": "0.1.0"})";
+
+    cppweb::Response headers = small;
+    for (int i = 0; i < 8; ++i) {
+        headers.headers["X-Custom-Header-" + std::to_string(i)] = "value-" + std::to_string(i);
+    }
+
+    cppweb::Response large;
+    large.content_type = "application/octet-stream";
+    large.body.assign(1 << 20, 'x');
+
+    cppweb::Response shared;
+    shared.content_type = "application/octet-stream";
+    shared.set_shared_body(std::make_shared<const std::string>(1 << 20, 'x'));
+
+    struct Case { const char* name; const cppweb::Response* res; };
+    const Case cases[] = {
+        {"serialize/small_json", &small},
+        {"serialize/8_custom_headers", &headers},
+        {"serialize/1mb_body", &large},
+        {"serialize/1mb_shared_body", &shared},
+    };
+
+    // Mirrors what the server assembles before its gathered write to the socket
+    for (const auto& c : cases) {
+        if (!selected(options, c.name)) continue;
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                const cppweb::Response& res = *c.res;
+                std::string head = cppweb::utils::format_response_head(res, res.body_size());
+                std::vector<iovec> iov;
+                iov.push_back({head.data(), head.size()});
+                if (res.segments.empty()) {
+                    iov.push_back({const_cast<char*>(res.body.data()), res.body.size()});
+                } else {
+                    for (const auto& segment : res.segments) {
+                        iov.push_back({const_cast<char*>(segment.data), segment.size});
+                    }
+                }
+                do_not_optimize(iov);
+            }
+        });
+        report(c.name, result);
+    }
+
+    // What a handler pays to answer with a cached 1 MB payload
+    auto cached = std::make_shared<const std::string>(1 << 20, 'x');
+    if (selected(options, "handler/cached_1mb_copy")) {
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                cppweb::Response res;
+                res.body = *cached;
+                do_not_optimize(res);
+            }
+        });
+        report("handler/cached_1mb_copy", result);
+    }
+    if (selected(options, "handler/cached_1mb_shared")) {
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                cppweb::Response res;
+                res.set_shared_body(cached);
+                do_not_optimize(res);
+            }
+        });
+        report("handler/cached_1mb_shared", result);
+    }
+}
+
+// --- ThreadPool ------------------------------------------------------------
+
+void bench_thread_pool(const BenchOptions& options) {
+    for (size_t threads : {1, 4, 8}) {
+        std::string name = "thread_pool/enqueue_run/" + std::to_string(threads) + "_threads";
+        if (!selected(options, name)) continue;
+
+        cppweb::threading::ThreadPool pool(threads);
+        std::atomic<uint64_t> done{0};
+
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            done.store(0);
+            for (uint64_t i = 0; i < n; ++i) {
+                pool.enqueue([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+            while (done.load(std::memory_order_relaxed) < n) {
+                std::this_thread::yield();
+            }
+        });
+        report(name, result);
+    }
+}
+
+// --- Instrumentation -------------------------------------------------------
+
+void bench_instrumentation(const BenchOptions& options) {
+    if (selected(options, "metrics/record_request")) {
+        cppweb::observability::MetricsRegistry registry;
+        const std::string method = "GET";
+        const std::string route = "/api/status";
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                registry.record_request({method, route, 200, 1500 + (i & 1023), 25000 + (i & 4095), 78, 120,
+                                         nullptr, false});
+            }
+        });
+        report("metrics/record_request", result);
+    }
+
+    // Everything an HTTP/1.1 connection records: open, queue wait, request, close
+    if (selected(options, "metrics/connection")) {
+        cppweb::observability::MetricsRegistry registry;
+        const std::string method = "GET";
+        const std::string route = "/api/status";
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                uint64_t queue_wait_ns = 4000 + (i & 2047);
+                registry.connection_opened();
+                registry.record_request({method, route, 200, 1500 + (i & 1023), 25000 + (i & 4095), 78, 120,
+                                         &queue_wait_ns, true});
+            }
+        });
+        report("metrics/connection", result);
+    }
+
+    if (selected(options, "tracer/sample_disabled")) {
+        cppweb::observability::Tracer tracer;
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                uint64_t id = tracer.sample();
+                do_not_optimize(id);
+            }
+        });
+        report("tracer/sample_disabled", result);
+    }
+}
+
+// --- FormParser ------------------------------------------------------------
+
+void bench_form(const BenchOptions& options) {
+    const std::string boundary = "----cppweb-bench-7f3a9c";
+    std::string body = "--" + boundary + "\r\n"
+        "Content-Disposition: form-data; name=\"title\"\r\n\r\n"
+        "holiday photos\r\n"
+        "--" + boundary + "\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"data.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n";
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < 1024 * 1024; ++i) {
+        body += static_cast<char>(rng() & 0xff);
+    }
+    body += "\r\n--" + boundary + "--\r\n";
+
+    const std::string content_type = "multipart/form-data; boundary=" + boundary;
+    cppweb::utils::FormLimits limits;
+    limits.spill_threshold = body.size(); // measure parsing, not the disk
+
+    if (selected(options, "form/multipart_1mb")) {
+        BenchResult result = run_batches(options.min_time, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                cppweb::utils::FormParser parser(content_type, limits);
+                for (size_t pos = 0; pos < body.size(); pos += 64 * 1024) {
+                    parser.feed(body.data() + pos, std::min<size_t>(64 * 1024, body.size() - pos));
+                }
+                bool ok = parser.finish();
+                do_not_optimize(ok);
+            }
+        });
+        report("form/multipart_1mb", result);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.min_time = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--min-time SECONDS]\n";
+            return 1;
+        }
+    }
+
+    bench_parse(options);
+    bench_route(options);
+    bench_serialize(options);
+    bench_thread_pool(options);
+    bench_instrumentation(options);
+    bench_form(options);
+    return 0;
+}
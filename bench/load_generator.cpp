@@ -0,0 +1,389 @@
+// HTTP/1.1 load generator with closed-loop and open-loop modes.
+//
+// By default it starts an in-process Server on the loopback interface and
+// drives it, so it needs no network access or external tools. Point it at a
+// running instance with --connect HOST:PORT instead.
+//
+// Closed loop: every connection sends its next request as soon as the
+// previous response arrived. Open loop (--rate): requests are scheduled at a
+// fixed aggregate rate and latency is measured from the scheduled send time,
+// so a stalled server cannot hide queueing delay (coordinated omission).
+//
+// --unix PATH sends the requests over a Unix domain socket instead of
+// loopback TCP; running the same load both ways compares the two transports.
+
+#include "../include/cppweb.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+using cppweb::observability::LatencyHistogram;
+using cppweb::observability::now_ns;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 18080;
+    std::string unix_path; // connect over this Unix socket instead of TCP
+    bool self_host = true;
+    size_t server_threads = 4;
+    size_t connections = 16;
+    double duration = 5.0;
+    double warmup = 0.5;
+    double rate = 0.0; // requests per second across all connections; 0 = closed loop
+    std::string path = "/";
+    bool keep_alive = true;
+};
+
+struct WorkerStats {
+    LatencyHistogram latency;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t connects = 0;
+    uint64_t bytes = 0;
+};
+
+bool iequals_prefix(const std::string& haystack, size_t pos, const char* needle) {
+    size_t len = std::strlen(needle);
+    if (pos + len > haystack.size()) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (std::tolower(static_cast<unsigned char>(haystack[pos + i])) != needle[i]) return false;
+    }
+    return true;
+}
+
+// Finds a header value in a response head, matching the name case-insensitively
+std::string find_header(const std::string& head, const char* lower_name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < head.size()) {
+        size_t line_start = pos + 2;
+        size_t line_end = head.find("\r\n", line_start);
+        if (line_end == std::string::npos) break;
+        if (iequals_prefix(head, line_start, lower_name) &&
+            head[line_start + std::strlen(lower_name)] == ':') {
+            size_t value_start = head.find_first_not_of(" \t", line_start + std::strlen(lower_name) + 1);
+            if (value_start == std::string::npos || value_start > line_end) return "";
+            return head.substr(value_start, line_end - value_start);
+        }
+        pos = line_end;
+    }
+    return "";
+}
+
+class Connection {
+public:
+    Connection(const Options& options, WorkerStats& stats) : options(options), stats(stats) {}
+    ~Connection() { disconnect(); }
+
+    // Sends one request and reads the full response; returns false on any error
+    bool round_trip(const std::string& request) {
+        if (fd < 0 && !connect_socket()) {
+            return false;
+        }
+
+        const char* ptr = request.data();
+        size_t remaining = request.size();
+        while (remaining > 0) {
+            ssize_t sent = ::send(fd, ptr, remaining, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                disconnect();
+                return false;
+            }
+            ptr += sent;
+            remaining -= static_cast<size_t>(sent);
+        }
+
+        return read_response();
+    }
+
+private:
+    const Options& options;
+    WorkerStats& stats;
+    int fd = -1;
+    std::string buffer;
+
+    bool connect_socket() {
+        bool connected;
+        if (!options.unix_path.empty()) {
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) return false;
+
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            options.unix_path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+            connected = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        } else {
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0) return false;
+
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(options.port));
+            connected = inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) == 1 &&
+                        ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        }
+        if (!connected) {
+            disconnect();
+            return false;
+        }
+        ++stats.connects;
+        buffer.clear();
+        return true;
+    }
+
+    void disconnect() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool fill() {
+        char chunk[16384];
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    bool read_response() {
+        size_t head_end;
+        while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                disconnect();
+                return false;
+            }
+        }
+
+        std::string head = buffer.substr(0, head_end + 2);
+        size_t body_start = head_end + 4;
+        bool close_after = iequals_prefix(find_header(head, "connection"), 0, "close");
+        std::string length_value = find_header(head, "content-length");
+
+        size_t total;
+        if (!length_value.empty()) {
+            total = body_start + std::strtoull(length_value.c_str(), nullptr, 10);
+            while (buffer.size() < total) {
+                if (!fill()) {
+                    disconnect();
+                    return false;
+                }
+            }
+        } else {
+            // No length: the body runs until the server closes the connection
+            while (fill()) {}
+            total = buffer.size();
+            close_after = true;
+        }
+
+        stats.bytes += total;
+        buffer.erase(0, total);
+        if (close_after) {
+            disconnect();
+        }
+        return head.compare(0, 9, "HTTP/1.1 ") == 0 || head.compare(0, 9, "HTTP/1.0 ") == 0;
+    }
+};
+
+void run_worker(const Options& options, size_t index, std::atomic<bool>& measuring,
+                std::atomic<bool>& done, WorkerStats& stats) {
+    std::string request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host + "\r\n"
+                        + "User-Agent: cppweb-loadgen\r\n"
+                        + (options.keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n")
+                        + "\r\n";
+
+    Connection connection(options, stats);
+    bool open_loop = options.rate > 0;
+    uint64_t interval_ns = open_loop
+        ? static_cast<uint64_t>(1e9 * static_cast<double>(options.connections) / options.rate)
+        : 0;
+    // Stagger connections so open-loop arrivals are spread evenly
+    uint64_t next_send = now_ns() + (open_loop ? interval_ns * index / options.connections : 0);
+
+    while (!done.load(std::memory_order_relaxed)) {
+        uint64_t scheduled = now_ns();
+        if (open_loop) {
+            while (scheduled < next_send) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<uint64_t>(next_send - scheduled, 1000000)));
+                if (done.load(std::memory_order_relaxed)) return;
+                scheduled = now_ns();
+            }
+            scheduled = next_send;
+            next_send += interval_ns;
+        }
+
+        bool ok = connection.round_trip(request);
+        uint64_t finished = now_ns();
+
+        if (!measuring.load(std::memory_order_relaxed)) continue;
+        if (ok) {
+            ++stats.requests;
+            stats.latency.record(finished - scheduled);
+        } else {
+            ++stats.errors;
+        }
+    }
+}
+
+void print_usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "  --connect HOST:PORT   drive an existing server instead of an in-process one\n"
+              << "  --port N              port for the in-process server (default 18080)\n"
+              << "  --unix PATH           use this Unix socket instead of TCP (the in-process server listens on both)\n"
+              << "  --server-threads N    worker threads for the in-process server (default 4)\n"
+              << "  --connections N       concurrent connections (default 16)\n"
+              << "  --duration SECONDS    measured run time (default 5)\n"
+              << "  --warmup SECONDS      unmeasured warmup (default 0.5)\n"
+              << "  --rate N              open loop at N req/s total (default: closed loop)\n"
+              << "  --path PATH           request path (default /)\n"
+              << "  --no-keep-alive       send Connection: close\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--connect" && has_value) {
+            std::string target = argv[++i];
+            size_t colon = target.rfind(':');
+            if (colon == std::string::npos) return false;
+            options.host = target.substr(0, colon);
+            options.port = std::atoi(target.c_str() + colon + 1);
+            options.self_host = false;
+        } else if (arg == "--unix" && has_value) {
+            options.unix_path = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--server-threads" && has_value) {
+            options.server_threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--connections" && has_value) {
+            options.connections = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--duration" && has_value) {
+            options.duration = std::atof(argv[++i]);
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::atof(argv[++i]);
+        } else if (arg == "--rate" && has_value) {
+            options.rate = std::atof(argv[++i]);
+        } else if (arg == "--path" && has_value) {
+            options.path = argv[++i];
+        } else if (arg == "--no-keep-alive") {
+            options.keep_alive = false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<cppweb::Server> server;
+    std::thread server_thread;
+    if (options.self_host) {
+        server = std::make_unique<cppweb::Server>(options.server_threads);
+        server->get("/", [](const cppweb::Request&, cppweb::Response& res) {
+            res.body = "Hello from libcppweb!";
+        });
+        server->get("/api/status", [](const cppweb::Request&, cppweb::Response& res) {
+            res.body = R"({"status": "ok", "version": "0.1.0"})";
+            res.content_type = "application/json";
+        });
+        try {
+            server->add_listener(cppweb::net::Endpoint::tcp(options.host, options.port));
+            if (!options.unix_path.empty()) {
+                server->add_listener(cppweb::net::Endpoint::unix_socket(options.unix_path));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Server failed: " << e.what() << "\n";
+            return 1;
+        }
+        server_thread = std::thread([&] { server->run(); });
+        while (!server->is_running()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::atomic<bool> measuring{false};
+    std::atomic<bool> done{false};
+    std::vector<WorkerStats> stats(options.connections);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.connections; ++i) {
+        workers.emplace_back(run_worker, std::cref(options), i, std::ref(measuring), std::ref(done), std::ref(stats[i]));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.warmup));
+    uint64_t start = now_ns();
+    measuring.store(true);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    measuring.store(false);
+    double elapsed = static_cast<double>(now_ns() - start) / 1e9;
+    done.store(true);
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (server) {
+        server->stop();
+        server_thread.join();
+    }
+
+    WorkerStats total;
+    for (const auto& s : stats) {
+        total.latency.merge(s.latency);
+        total.requests += s.requests;
+        total.errors += s.errors;
+        total.connects += s.connects;
+        total.bytes += s.bytes;
+    }
+
+    auto ms = [](uint64_t ns) { return static_cast<double>(ns) / 1e6; };
+    std::cout << std::fixed << std::setprecision(3)
+              << "mode:         " << (options.rate > 0 ? "open loop" : "closed loop")
+              << ", " << options.connections << " connections"
+              << (options.keep_alive ? ", keep-alive" : ", connection: close") << "\n"
+              << "target:       "
+              << (options.unix_path.empty() ? options.host + ":" + std::to_string(options.port) : "unix:" + options.unix_path)
+              << options.path
+              << (options.self_host ? " (in-process)" : "") << "\n"
+              << "requests:     " << total.requests << " in " << elapsed << " s\n"
+              << "throughput:   " << std::setprecision(1) << static_cast<double>(total.requests) / elapsed << " req/s, "
+              << static_cast<double>(total.bytes) / elapsed / (1024 * 1024) << " MiB/s\n"
+              << "errors:       " << total.errors << "\n"
+              << "connects:     " << total.connects << "\n"
+              << std::setprecision(3)
+              << "latency ms:   p50 " << ms(total.latency.percentile(50))
+              << "  p90 " << ms(total.latency.percentile(90))
+              << "  p99 " << ms(total.latency.percentile(99))
+              << "  p99.9 " << ms(total.latency.percentile(99.9))
+              << "  max " << ms(total.latency.percentile(100)) << "\n";
+
+    return total.requests > 0 ? 0 : 2;
+}
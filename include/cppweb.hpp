@@ -12,7 +12,26 @@
 #include "cppweb/routing/router.hpp"
 
 // Threading
+#include "cppweb/threading/executor.hpp"
 #include "cppweb/threading/thread_pool.hpp"
 
+// HTTP/2
+#include "cppweb/http2/hpack.hpp"
+#include "cppweb/http2/connection.hpp"
+
+// Listeners and transports
+#include "cppweb/net/listener.hpp"
+#include "cppweb/net/transport.hpp"
+#ifdef CPPWEB_WITH_TLS
+#include "cppweb/net/tls.hpp"
+#endif
+
+// Observability
+#include "cppweb/observability/metrics.hpp"
+#include "cppweb/observability/tracer.hpp"
+#include "cppweb/observability/access_log.hpp"
+
 // Utilities
 #include "cppweb/utils/http_utils.hpp"
+#include "cppweb/utils/form_parser.hpp"
+#include "cppweb/utils/mapped_file.hpp"
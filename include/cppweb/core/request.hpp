@@ -2,15 +2,43 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace cppweb {
 
+    // One field of a multipart/form-data or application/x-www-form-urlencoded body
+    struct FormPart {
+        std::string name;
+        std::string filename;     // set for file uploads
+        std::string content_type;
+        std::map<std::string, std::string> headers;
+        std::string data;         // the contents, unless they were spilled to disk
+        std::string file_path;    // temp file holding the contents of a large upload
+        size_t size = 0;
+
+        // Removes the temp file once the last copy of the part is gone;
+        // rename the file elsewhere to keep it.
+        std::shared_ptr<void> file_guard;
+
+        bool in_memory() const { return file_path.empty(); }
+    };
+
     struct Request {
         std::string method;
         std::string path;
         std::string body;
         std::map<std::string, std::string> headers;
         std::map<std::string, std::string> query_params;
+        std::vector<FormPart> parts; // parsed form body when Server::enable_form_parsing() is on
+
+        // First form part with the given name, or nullptr
+        const FormPart* find_part(const std::string& name) const {
+            for (const auto& part : parts) {
+                if (part.name == name) return &part;
+            }
+            return nullptr;
+        }
     };
 
-} // namespace cppweb
\ No newline at end of file
+} // namespace cppweb
@@ -1,10 +1,26 @@
 #pragma once
 
 #include <string>
+#include <algorithm>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace cppweb {
 
+    // A read-only byte range sent as part of a response body without being
+    // copied; `owner` keeps the memory alive until the response is sent
+    struct BodySegment {
+        std::shared_ptr<const void> owner;
+        const char* data = nullptr;
+        size_t size = 0;
+        // For a mapped file: the file and offset the bytes can be read from
+        // instead, which transports that would copy them in user space do
+        int file_fd = -1;
+        uint64_t file_offset = 0;
+    };
+
     struct Response {
         int status_code = 200;
         std::string body;
@@ -12,7 +28,38 @@ namespace cppweb {
         std::string content_type = "text/plain";
         std::map<std::string, std::string> headers;
 
+        // Scatter list of shared buffers; when non-empty it is sent instead of `body`
+        std::vector<BodySegment> segments;
+
         Response() = default;
+
+        // Use a shared, immutable buffer (e.g. a cached payload) as the whole body
+        void set_shared_body(std::shared_ptr<const std::string> shared) {
+            segments.clear();
+            append_shared(std::move(shared));
+        }
+
+        // Append part of a shared, immutable buffer to the body
+        void append_shared(std::shared_ptr<const std::string> shared, size_t offset = 0,
+                           size_t length = std::string::npos) {
+            if (!shared || offset >= shared->size()) return;
+            size_t size = std::min(length, shared->size() - offset);
+            const char* data = shared->data() + offset;
+            segments.push_back({std::move(shared), data, size, -1, 0});
+        }
+
+        // Append any segment, e.g. a region of a utils::MappedFile
+        void append_segment(BodySegment segment) {
+            if (segment.size > 0) segments.push_back(std::move(segment));
+        }
+
+        // Length of the body that will be sent, ignoring file_path
+        size_t body_size() const {
+            if (segments.empty()) return body.size();
+            size_t total = 0;
+            for (const auto& segment : segments) total += segment.size;
+            return total;
+        }
     };
 
 
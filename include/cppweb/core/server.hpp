@@ -4,8 +4,23 @@
 #include "response.hpp"
 #include "../routing/router.hpp"
 #include "../threading/thread_pool.hpp"
+#include "../threading/executor.hpp"
+#include "../observability/metrics.hpp"
+#include "../observability/tracer.hpp"
+#include "../observability/access_log.hpp"
+#include "../http2/connection.hpp"
+#include "../net/idle_watcher.hpp"
+#include "../net/listener.hpp"
+#include "../net/transport.hpp"
+#include "../utils/form_parser.hpp"
+#ifdef CPPWEB_WITH_TLS
+#include "../net/tls.hpp"
+#endif
+#include <atomic>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace cppweb {
 
@@ -24,6 +39,13 @@ public:
      */
     explicit Server(size_t num_threads = 4);
 
+    /**
+     * @brief Constructor for a server whose thread pool grows and shrinks with load
+     * @param pool_options Worker bounds, target queue wait and idle timeout; resizes
+     *        are also counted in the metrics registry
+     */
+    explicit Server(const threading::PoolOptions& pool_options);
+
     /**
      * @brief Destructor
      */
@@ -64,28 +86,302 @@ public:
      */
     void del(const std::string& path, RouteHandler handler);
 
+    /**
+     * @brief Create a named executor that routes can be assigned to
+     *
+     * Call before listen()/run().
+     * @param name Name to refer to it by; "inline" is reserved
+     * @param options Thread count, queue limit and what to do when the queue is full
+     * @throws std::invalid_argument If the name is taken or reserved, or threads is 0
+     */
+    void add_executor(const std::string& name, const threading::ExecutorOptions& options);
+
+    /**
+     * @brief Serve a route on a named executor instead of the connection's worker
+     * @param method The HTTP method, e.g. "POST"
+     * @param path The URL path as registered
+     * @param executor A name passed to add_executor(), or "inline" to run on the I/O pool
+     * @throws std::invalid_argument If the executor does not exist
+     */
+    void assign_executor(const std::string& method, const std::string& path, const std::string& executor);
+
+    /**
+     * @brief Executor for routes without an assignment of their own
+     * @param executor A name passed to add_executor(), or "inline" (the default)
+     * @throws std::invalid_argument If the executor does not exist
+     */
+    void set_default_executor(const std::string& executor);
+
+    /**
+     * @brief Look up an executor, e.g. for its stats
+     * @return The executor, or nullptr if there is none by that name
+     */
+    const threading::Executor* get_executor(const std::string& name) const;
+
+    /**
+     * @brief Expose collected metrics in the Prometheus text format
+     * @param path The URL path to serve them on (default: "/metrics")
+     */
+    void enable_metrics(const std::string& path = "/metrics");
+
+    /**
+     * @brief Access the metrics registry fed by this server
+     * @return The registry, which lives as long as the server
+     */
+    observability::MetricsRegistry& get_metrics() { return *metrics; }
+
+    /**
+     * @brief Access the worker pool, e.g. for its size and resize counters
+     * @return The pool, which lives as long as the server
+     */
+    const threading::ThreadPool& get_thread_pool() const { return *thread_pool; }
+
+    /**
+     * @brief Trace a sample of requests phase by phase
+     * @param sample_rate Fraction of requests to trace, in [0, 1]; 0 turns tracing off
+     * @param path Optional URL path serving the buffered spans as Chrome trace JSON
+     */
+    void enable_tracing(double sample_rate, const std::string& path = "");
+
+    /**
+     * @brief Access the request tracer
+     * @return The tracer, which lives as long as the server
+     */
+    observability::Tracer& get_tracer() { return *tracer; }
+
+    /**
+     * @brief Write an access log line for every request
+     *
+     * Call before listen(). Logging happens on a background thread; request
+     * threads never block on it.
+     * @param config Format, destination and buffering settings
+     * @throws std::runtime_error If the log file cannot be opened
+     */
+    void enable_access_log(const observability::AccessLogConfig& config = observability::AccessLogConfig());
+
+    /**
+     * @brief Access the access log
+     * @return The log, or nullptr if enable_access_log() was not called
+     */
+    observability::AccessLog* get_access_log() { return access_log.get(); }
+
+    /**
+     * @brief Parse form bodies into Request::parts before handlers run
+     *
+     * multipart/form-data and application/x-www-form-urlencoded bodies are
+     * parsed while they are read, leaving Request::body empty. Large file
+     * parts are written to temp files that are removed after the request.
+     * Bodies that break a limit are answered with 413, malformed ones with
+     * 400, without calling the handler.
+     * @param limits Part counts, sizes and the spill threshold
+     */
+    void enable_form_parsing(const utils::FormLimits& limits = utils::FormLimits());
+
+    /**
+     * @brief Turn HTTP/2 cleartext (h2c) support on or off
+     *
+     * Off by default; call before listen()/run(). Connections that open with
+     * the HTTP/2 preface (prior knowledge) and HTTP/1.1 requests carrying
+     * "Upgrade: h2c" are then served over HTTP/2; everything else stays on
+     * HTTP/1.1. An idle HTTP/2 connection holds no worker thread: its socket
+     * waits in a shared watcher, and each stream's handler runs as a task of
+     * its own so slow streams do not delay the others.
+     * @param enabled Whether to accept HTTP/2
+     * @param settings Stream limits, flow-control windows and idle timeout
+     */
+    void enable_http2(bool enabled = true, const http2::ConnectionSettings& settings = http2::ConnectionSettings());
+
+#ifdef CPPWEB_WITH_TLS
+    /**
+     * @brief Serve HTTPS instead of plain HTTP
+     *
+     * Call before listen(). The handshake runs on the worker thread that
+     * serves the connection. ALPN selects HTTP/2 or HTTP/1.1, and sessions
+     * are resumed through a cache and tickets shared by all workers. File
+     * bodies are sent with sendfile() when the kernel supports TLS offload.
+     * @param config Certificate, key, ALPN and session settings
+     * @throws std::runtime_error If the certificate or key cannot be loaded
+     */
+    void enable_tls(const net::TlsConfig& config);
+
+    /**
+     * @brief Access the TLS context
+     * @return The context, or nullptr if enable_tls() was not called
+     */
+    net::TlsContext* get_tls_context() { return tls.get(); }
+#endif
+
+    /**
+     * @brief Add an endpoint to accept connections on
+     *
+     * The socket is bound right away, so address and permission errors are
+     * reported here; connections are accepted once run() starts. All
+     * endpoints share the router and worker threads.
+     * @param endpoint A TCP (IPv4/IPv6) or Unix domain socket endpoint
+     * @return The bound TCP port (useful when asking for port 0), or 0 for Unix sockets
+     * @throws std::runtime_error If the socket cannot be created, bound or listened on
+     */
+    int add_listener(const net::Endpoint& endpoint);
+
+    /**
+     * @brief Accept connections on every added endpoint until stop() is called
+     *
+     * The endpoints are closed when run() returns and bound again, on the
+     * same ports, by the next run().
+     * @throws std::runtime_error If no endpoint was added, or one cannot be bound again
+     */
+    void run();
+
     /**
      * @brief Start listening for incoming connections
+     *
+     * Shorthand for add_listener(net::Endpoint::tcp("0.0.0.0", port)) followed by run().
      * @param port The port to listen on
      */
     void listen(int port);
 
+    /**
+     * @brief Stop accepting connections and make run() and listen() return
+     *
+     * Safe to call from any thread, including route handlers. Connections
+     * already queued are still served. Called while run() is not active, it
+     * makes the next run() return at once.
+     */
+    void stop();
+
+    /**
+     * @brief Check whether the server is accepting connections
+     * @return True from the start of run() until stop()
+     */
+    bool is_running() const { return running.load(); }
+
 private:
     std::unique_ptr<threading::ThreadPool> thread_pool;
     std::unique_ptr<Router> router;
+    std::unique_ptr<observability::MetricsRegistry> metrics;
+    std::unique_ptr<observability::Tracer> tracer;
+    std::unique_ptr<observability::AccessLog> access_log;
+    std::atomic<bool> running{false};
+    std::vector<std::unique_ptr<net::Listener>> listeners;
+    std::vector<net::Endpoint> closed_endpoints; // reopened by the next run()
+    // stop() wakes run() through this pipe; it lives as long as the Server
+    // so stop() never writes to a descriptor that was closed or reused
+    int wake_read_fd = -1;
+    int wake_write_fd = -1;
+    bool http2_enabled = false;
+    http2::ConnectionSettings http2_settings;
+    bool form_parsing = false;
+    utils::FormLimits form_limits;
+    std::map<std::string, std::unique_ptr<threading::Executor>> executors;
+    std::string default_executor = threading::Executor::kInline;
+#ifdef CPPWEB_WITH_TLS
+    std::unique_ptr<net::TlsContext> tls;
+#endif
+    // Idle HTTP/2 connections wait here instead of on a worker; created by run()
+    std::unique_ptr<net::IdleWatcher> idle_watcher;
+
+    /**
+     * @brief Create the stop() wakeup pipe; called by the constructors
+     * @throws std::runtime_error If the pipe cannot be created
+     */
+    void open_wake_pipe();
+
+    /**
+     * @brief Hand an accepted connection to the thread pool
+     * @param client_fd The client socket file descriptor
+     * @param use_tls Whether the endpoint it arrived on serves TLS
+     */
+    void enqueue_connection(int client_fd, bool use_tls);
 
     /**
      * @brief Handle a client connection
      * @param client_fd The client socket file descriptor
+     * @param accepted_ns Monotonic timestamp taken when the connection was accepted
+     * @param trace_id Tracer request id, or 0 if the request is not sampled
+     * @param use_tls Whether to run a TLS handshake (when TLS is enabled)
+     */
+    void handle_client(int client_fd, uint64_t accepted_ns, uint64_t trace_id, bool use_tls);
+
+    struct ClientConnection;
+    struct Http2Session;
+
+    /**
+     * @brief Find the executor that should serve a request, from its request line
+     * @param raw_request Bytes read so far, starting with the request line
+     * @param method Set to the request method
+     * @param path Set to the request path without its query
+     * @return The executor, or nullptr to serve the request on the current thread
+     */
+    threading::Executor* executor_for_request(const std::string& raw_request, std::string& method, std::string& path) const;
+
+    /**
+     * @brief Find the executor assigned to a route, or the default one
+     * @return The executor, or nullptr if the route runs on the server's workers
+     */
+    threading::Executor* executor_for(const std::string& method, const std::string& path) const;
+
+    /**
+     * @brief Read, route and answer the request of an HTTP/1.1 connection
+     * @param conn The connection, with whatever was read of the request so far
+     */
+    void serve_http1(const std::shared_ptr<ClientConnection>& conn);
+
+    /**
+     * @brief Answer 503 for a request whose executor refused it or gave up waiting
+     *
+     * Reads and discards the rest of the request before the connection
+     * closes, so a reset does not destroy the response.
+     */
+    void reject_overloaded(ClientConnection& conn, const std::string& method, const std::string& path);
+
+    /**
+     * @brief Switch a connection to HTTP/2 and serve what has arrived so far
+     *
+     * Returns once the connection is waiting for the peer; it is then served
+     * again by the pool when its socket becomes readable.
+     * @param conn The client connection
+     * @param initial_input Bytes already read, starting with the client preface
+     * @param upgraded The request that asked for h2c, or nullptr for prior knowledge
+     * @param upgraded_bytes Bytes read for the upgraded request
+     */
+    void serve_http2(const std::shared_ptr<ClientConnection>& conn, std::string initial_input, Request* upgraded,
+                     uint64_t upgraded_bytes);
+
+    /**
+     * @brief Ask for an HTTP/2 connection to be serviced on the pool
+     *
+     * Called when its socket is readable, it idled out or a handler finished.
+     * Requests that arrive while it is being serviced make that pass run again.
+     */
+    void wake_http2(const std::shared_ptr<Http2Session>& session);
+
+    /**
+     * @brief Service an HTTP/2 connection until no wakeups are pending, then park it
+     */
+    void drive_http2(const std::shared_ptr<Http2Session>& session);
+
+    /**
+     * @brief Route a request, turning handler exceptions into a 500 response
+     * @return True if a route matched
+     */
+    bool dispatch(const Request& req, Response& res);
+
+    /**
+     * @brief Feed one finished request into metrics and the access log
+     * @param closing The HTTP/1.1 connection this request ends; its queue wait
+     *                and close are recorded in the same update. Null for HTTP/2 streams.
      */
-    void handle_client(int client_fd);
+    void record_exchange(const Request& req, const Response& res, bool matched, const char* protocol,
+                         const std::string& remote, uint64_t handler_ns, uint64_t latency_ns,
+                         uint64_t bytes_in, uint64_t bytes_out, ClientConnection* closing);
 
     /**
      * @brief Send an HTTP response to a client
-     * @param client_fd The client socket file descriptor
+     * @param transport The client connection
      * @param res The response to send
+     * @return The number of bytes written to the socket
      */
-    void send_response(int client_fd, const Response& res);
+    size_t send_response(net::Transport& transport, const Response& res);
 };
 
 } // namespace cppweb
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "hpack.hpp"
+#include "../core/request.hpp"
+#include "../core/response.hpp"
+#include "../net/transport.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cppweb::http2 {
+
+/**
+ * @brief The 24-byte client connection preface (RFC 7540, section 3.5)
+ */
+extern const std::string kClientPreface;
+
+/**
+ * @brief Check whether data read so far could be the start of an HTTP/2 preface
+ * @param data The bytes received on a new connection
+ * @return True if data is a (possibly partial) prefix of kClientPreface
+ */
+bool starts_like_preface(const std::string& data);
+
+/**
+ * @brief Check whether an HTTP/1.1 request asks to upgrade to h2c
+ * @param req The parsed request
+ * @return True if Upgrade names h2c and an HTTP2-Settings header is present
+ */
+bool is_h2c_upgrade(const Request& req);
+
+/**
+ * @brief Limits and windows the server advertises to clients
+ */
+struct ConnectionSettings {
+    uint32_t max_concurrent_streams = 100;
+    uint32_t initial_window_size = 1 << 20;     // per-stream receive window
+    uint32_t connection_window_size = 1 << 24;  // connection receive window
+    uint32_t max_frame_size = 16384;            // largest frame we accept
+    uint32_t max_header_list_size = 64 * 1024;
+    size_t write_batch_bytes = 64 * 1024;       // output is flushed once this much is queued
+    std::chrono::milliseconds idle_timeout{30000};
+};
+
+/**
+ * @brief Timings and sizes for one completed stream
+ */
+struct StreamStats {
+    uint32_t stream_id = 0;
+    bool matched = false;
+    uint64_t started_ns = 0;        // request headers complete
+    uint64_t handler_start_ns = 0;
+    uint64_t handler_end_ns = 0;
+    uint64_t finished_ns = 0;       // last DATA frame queued
+    uint64_t bytes_in = 0;          // header block and DATA payload
+    uint64_t bytes_out = 0;         // HEADERS and DATA frames, including frame headers
+};
+
+/**
+ * @class BodySink
+ * @brief Consumes a request body as its DATA frames arrive, instead of Request::body
+ */
+class BodySink {
+public:
+    virtual ~BodySink() = default;
+
+    /**
+     * @brief Take the next piece of the body; called on the connection's thread
+     * @return False to refuse the body; the rest of it is then discarded
+     */
+    virtual bool write(const char* data, size_t len) = 0;
+
+    /**
+     * @brief Complete the request once END_STREAM arrived; called on the handler's thread
+     * @return False if the body was refused; res then holds the response and the route is not run
+     */
+    virtual bool finish(Request& req, Response& res) = 0;
+};
+
+/**
+ * @brief Hooks connecting a Connection to the application
+ */
+struct ConnectionCallbacks {
+    // Runs the route for a complete request and may consume its body; returns false if no route matched
+    std::function<bool(Request&, Response&)> dispatch;
+    // Optional; called once the last frame of a response has been queued
+    std::function<void(const Request&, const Response&, const StreamStats&)> completed;
+    // Optional; runs a stream's handler task (which calls dispatch) on another thread.
+    // Returns false to refuse it, and the stream is answered with 503. A task that
+    // was accepted but can no longer run is given up by calling the second
+    // function instead, which answers 503 the same way. Without it, handlers
+    // run inside service().
+    std::function<bool(const Request&, std::function<void()> task, std::function<void()> refuse)> submit;
+    // Optional; called on the handler's thread when a submitted task has finished,
+    // so the owner can schedule service() to send the response
+    std::function<void()> wake;
+    // Optional; called once a request's headers are complete. A sink it returns
+    // receives the request's DATA instead of Request::body.
+    std::function<std::shared_ptr<BodySink>(const Request&)> body_sink;
+};
+
+/**
+ * @class Connection
+ * @brief Server side of one HTTP/2 connection over a transport
+ *
+ * The connection is driven by its owner: service() reads whatever input has
+ * arrived without waiting for more, handles the frames and writes what can
+ * be sent, then returns so the thread can serve others while the socket is
+ * idle. Only one thread may call service() at a time.
+ *
+ * Each request is handed to the submit callback once its END_STREAM
+ * arrives, so slow handlers do not hold up the other streams; the
+ * connection thread only frames and writes. Responses from all streams are
+ * interleaved frame by frame under connection and stream flow control, and
+ * outgoing frames are collected in one buffer and written in batches.
+ */
+class Connection {
+public:
+    /**
+     * @brief Constructor
+     * @param transport The connection's byte stream (plain or TLS); not owned
+     * @param callbacks Dispatch and completion hooks
+     * @param settings Limits to advertise and enforce
+     */
+    Connection(net::Transport& transport, ConnectionCallbacks callbacks, ConnectionSettings settings = ConnectionSettings());
+    ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    /**
+     * @brief Adopt the request that carried an h2c upgrade as stream 1
+     *
+     * Call before start(), after the 101 response has been sent.
+     * @param req The upgraded HTTP/1.1 request, body included
+     * @param bytes_in Bytes read for the request
+     */
+    void adopt_upgrade(Request req, uint64_t bytes_in);
+
+    /**
+     * @brief Send the server SETTINGS; call once, before service()
+     * @param initial_input Bytes already read from the socket, starting with the client preface
+     * @return False if the socket failed
+     */
+    bool start(std::string initial_input);
+
+    /**
+     * @brief Handle the input that has arrived and finished handlers, then write what can be sent
+     *
+     * Never waits for the peer. When it returns true, call it again once
+     * the socket is readable or the wake callback ran.
+     * @return False once the connection is finished and the socket can be closed
+     */
+    bool service();
+
+    /**
+     * @brief Say goodbye to a connection that has been idle too long
+     *
+     * Sends GOAWAY so the client retries elsewhere; the connection is finished afterwards.
+     */
+    void close_idle();
+
+    /**
+     * @brief Whether submitted handlers are still running
+     *
+     * A connection waiting on its handlers is not idle.
+     */
+    bool handlers_running() const { return running_handlers > 0; }
+
+private:
+    struct Stream;
+    struct Handoff;
+
+    net::Transport& transport;
+    ConnectionCallbacks callbacks;
+    ConnectionSettings settings;
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+
+    // Shared with handler tasks, which may outlive a reset stream or the connection
+    std::map<uint32_t, std::shared_ptr<Stream>> streams;
+    uint32_t last_client_stream = 0;
+    std::shared_ptr<Handoff> handoff;
+    size_t running_handlers = 0;
+
+    // Header block being assembled across HEADERS and CONTINUATION frames
+    uint32_t continuation_stream = 0;
+    uint8_t continuation_flags = 0;
+    std::string header_block;
+
+    // Peer settings
+    uint32_t peer_max_frame_size = 16384;
+    int64_t peer_initial_window = 65535;
+
+    int64_t conn_send_window = 65535;
+    int64_t conn_recv_window;
+    uint64_t conn_recv_credit = 0;
+
+    std::string input;
+    std::string output;
+
+    // Response body slices to send after output[output_pos - 1], without
+    // copying them into output; flush() writes both with one writev
+    struct GatheredSlice {
+        size_t output_pos;
+        BodySegment segment;
+    };
+    std::vector<GatheredSlice> gathered;
+    size_t gathered_bytes = 0;
+    bool preface_received = false;
+    bool closing = false;       // GOAWAY sent or received; no new streams
+    bool dead = false;          // socket unusable; stop immediately
+
+    bool read_available();
+    bool process_input();
+    bool handle_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length);
+
+    bool on_data(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length);
+    bool on_headers(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length);
+    bool on_continuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length);
+    bool on_settings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length);
+    bool on_window_update(uint32_t stream_id, const uint8_t* payload, uint32_t length);
+    bool finish_header_block(uint32_t stream_id, uint8_t flags);
+    bool apply_setting(uint16_t id, uint32_t value);
+
+    void dispatch_ready_streams();
+    void collect_finished_handlers();
+    void start_response(Stream& stream);
+    bool pump_data();
+    void queue_body(Stream& stream, size_t length);
+    void finish_stream(uint32_t stream_id);
+
+    void queue_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const void* payload, size_t length);
+    void queue_settings();
+    void queue_window_update(uint32_t stream_id, uint32_t increment);
+    void reset_stream(uint32_t stream_id, uint32_t error_code);
+    bool connection_error(uint32_t error_code);
+    bool flush();
+};
+
+} // namespace cppweb::http2
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cppweb::http2 {
+
+using HeaderField = std::pair<std::string, std::string>;
+using HeaderList = std::vector<HeaderField>;
+
+/**
+ * @class HpackError
+ * @brief Thrown when a header block cannot be decoded (COMPRESSION_ERROR)
+ */
+class HpackError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @class HpackListTooLarge
+ * @brief Thrown when the decoded header list outgrows the allowed size (ENHANCE_YOUR_CALM)
+ */
+class HpackListTooLarge : public HpackError {
+public:
+    using HpackError::HpackError;
+};
+
+/**
+ * @class HpackTable
+ * @brief The HPACK dynamic table (RFC 7541, section 2.3.2)
+ */
+class HpackTable {
+public:
+    explicit HpackTable(size_t max_size = 4096) : max_size(max_size) {}
+
+    void add(const std::string& name, const std::string& value);
+    void set_max_size(size_t size);
+
+    size_t get_max_size() const { return max_size; }
+    size_t size() const { return current_size; }
+    size_t entry_count() const { return entries.size(); }
+
+    /**
+     * @brief Look up an entry in the combined static + dynamic index space
+     * @param index 1-based HPACK index
+     * @return The entry, or nullptr if the index is out of range
+     */
+    const HeaderField* get(size_t index) const;
+
+    /**
+     * @brief Find the best index for a header
+     * @param name The header name
+     * @param value The header value
+     * @param name_only Set to true if only the name matched
+     * @return The 1-based index, or 0 if nothing matched
+     */
+    size_t find(const std::string& name, const std::string& value, bool& name_only) const;
+
+private:
+    std::deque<HeaderField> entries; // newest first
+    size_t max_size;
+    size_t current_size = 0;
+
+    void evict_to(size_t limit);
+};
+
+/**
+ * @class HpackDecoder
+ * @brief Decodes HPACK header blocks into header lists
+ */
+class HpackDecoder {
+public:
+    /**
+     * @param max_table_size The SETTINGS_HEADER_TABLE_SIZE we advertised
+     * @param max_list_size The SETTINGS_MAX_HEADER_LIST_SIZE we advertised
+     */
+    explicit HpackDecoder(size_t max_table_size = 4096, size_t max_list_size = SIZE_MAX)
+        : table(max_table_size), settings_limit(max_table_size), max_list_size(max_list_size) {}
+
+    /**
+     * @brief Decode a complete header block
+     *
+     * The decoded size of the list (name + value + 32 per field, RFC 7541
+     * section 4.1) is checked as fields are produced, so a small block of
+     * indexed references cannot expand into an arbitrarily large list.
+     *
+     * @param data Pointer to the block
+     * @param length Length of the block in bytes
+     * @return The decoded header fields in order
+     * @throws HpackListTooLarge When the decoded list exceeds max_list_size;
+     *         the dynamic table is then out of sync and the connection must close
+     * @throws HpackError On malformed input
+     */
+    HeaderList decode(const uint8_t* data, size_t length);
+
+private:
+    HpackTable table;
+    size_t settings_limit;
+    size_t max_list_size;
+};
+
+/**
+ * @class HpackEncoder
+ * @brief Encodes header lists into HPACK header blocks
+ *
+ * Fields that repeat across responses (content-type, custom headers) are
+ * added to the dynamic table; values that rarely repeat, such as
+ * content-length, are sent as literals without indexing.
+ */
+class HpackEncoder {
+public:
+    explicit HpackEncoder(size_t max_table_size = 4096) : table(max_table_size) {}
+
+    /**
+     * @brief Apply the peer's SETTINGS_HEADER_TABLE_SIZE
+     * @param size The new limit; a size update is emitted in the next block
+     */
+    void set_max_table_size(size_t size);
+
+    /**
+     * @brief Append the encoding of a header list to a buffer
+     * @param headers The fields to encode; names must be lowercase
+     * @param out The buffer to append to
+     */
+    void encode(const HeaderList& headers, std::string& out);
+
+private:
+    HpackTable table;
+    bool pending_size_update = false;
+    size_t min_size_since_update = SIZE_MAX;
+};
+
+namespace hpack {
+
+/**
+ * @brief Append an HPACK prefix-encoded integer
+ * @param value The integer
+ * @param prefix_bits Number of bits available in the first byte (1-8)
+ * @param first_byte_flags Bits to OR into the first byte above the prefix
+ * @param out The buffer to append to
+ */
+void encode_integer(uint64_t value, unsigned prefix_bits, uint8_t first_byte_flags, std::string& out);
+
+/**
+ * @brief Append a string literal, Huffman-coded when that is shorter
+ */
+void encode_string(const std::string& value, std::string& out);
+
+/**
+ * @brief Huffman-encode a string (RFC 7541, Appendix B)
+ */
+std::string huffman_encode(const std::string& value);
+
+/**
+ * @brief Number of bytes huffman_encode would produce
+ */
+size_t huffman_encoded_length(const std::string& value);
+
+/**
+ * @brief Huffman-decode a string
+ * @throws HpackError On invalid codes or padding
+ */
+std::string huffman_decode(const uint8_t* data, size_t length);
+
+} // namespace hpack
+
+} // namespace cppweb::http2
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace cppweb::net {
+
+/**
+ * @class IdleWatcher
+ * @brief Waits on many idle sockets with one thread
+ *
+ * A connection with nothing to do registers its socket and returns its
+ * worker to the pool. The watcher's thread waits on all registered sockets
+ * with epoll and calls a socket's callback once, when it becomes readable
+ * or its timeout passes. Callbacks run on the watcher's thread and should
+ * only hand the connection back to a pool.
+ */
+class IdleWatcher {
+public:
+    /**
+     * @brief Called with true when the socket is readable, false when it timed out
+     */
+    using Callback = std::function<void(bool readable)>;
+
+    /**
+     * @brief Create the epoll instance and start the watcher thread
+     * @throws std::runtime_error If epoll or the wakeup eventfd cannot be created
+     */
+    IdleWatcher();
+
+    /**
+     * @brief Stop the thread; pending callbacks are dropped without being called
+     */
+    ~IdleWatcher();
+
+    IdleWatcher(const IdleWatcher&) = delete;
+    IdleWatcher& operator=(const IdleWatcher&) = delete;
+
+    /**
+     * @brief Wait for a socket to become readable, once
+     *
+     * Replaces any earlier registration of the same socket.
+     * @param fd The socket; must stay open until the callback ran or unwatch() was called
+     * @param timeout Time after which the callback runs with false; 0 waits indefinitely
+     * @param callback Called once from the watcher thread
+     * @return False if the watcher was stopped or the socket cannot be watched
+     */
+    bool watch(int fd, std::chrono::milliseconds timeout, Callback callback);
+
+    /**
+     * @brief Forget a socket's registration without calling its callback
+     *
+     * Call before closing a socket that may still be watched.
+     */
+    void unwatch(int fd);
+
+    /**
+     * @brief Stop the thread and drop every registration; watch() fails from then on
+     */
+    void stop();
+
+    /**
+     * @brief Number of sockets currently watched
+     */
+    size_t size() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Callback callback;
+        std::multimap<Clock::time_point, int>::iterator deadline;
+        bool has_deadline = false;
+    };
+
+    int epoll_fd = -1;
+    int wake_fd = -1;
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, Entry> entries;
+    std::multimap<Clock::time_point, int> deadlines;
+    bool stopped = false;
+
+    std::thread thread;
+
+    void loop();
+    void wake();
+    Callback take(int fd);
+};
+
+} // namespace cppweb::net
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <sys/types.h>
+#include <string>
+
+namespace cppweb::net {
+
+/**
+ * @brief Where and how a server accepts connections
+ */
+struct Endpoint {
+    enum class Kind { Tcp, Unix };
+
+    Kind kind = Kind::Tcp;
+    std::string address = "0.0.0.0"; // TCP: IPv4 or IPv6 literal; "::" accepts both families unless v6_only
+    int port = 0;                     // TCP: 0 picks a free port
+    std::string path;                 // Unix: filesystem path of the socket
+
+    int backlog = 511;
+    bool reuse_port = false;          // SO_REUSEPORT, for several processes on one port
+    bool v6_only = false;             // IPV6_V6ONLY for IPv6 addresses
+    int defer_accept_seconds = 0;     // TCP_DEFER_ACCEPT: wake accept only once data arrived
+    int fastopen_queue = 0;           // TCP_FASTOPEN pending-request queue; 0 disables it
+
+    mode_t permissions = 0660;        // Unix: mode applied to the socket file
+    bool tls = true;                  // use TLS here once Server::enable_tls() was called; unix_socket() clears it
+
+    /**
+     * @brief A TCP endpoint
+     * @param address IPv4 or IPv6 literal to bind to
+     * @param port The port
+     */
+    static Endpoint tcp(const std::string& address, int port);
+
+    /**
+     * @brief A Unix domain stream socket endpoint
+     *
+     * Serves plaintext even after Server::enable_tls(), since the peer is on
+     * the same host; set tls to encrypt it anyway.
+     * @param path Filesystem path of the socket; a stale socket there is replaced,
+     *             one another process still listens on is not
+     * @param permissions Mode for the socket file
+     */
+    static Endpoint unix_socket(const std::string& path, mode_t permissions = 0660);
+
+    /**
+     * @brief Human-readable form, e.g. "0.0.0.0:8080", "[::1]:8080" or "unix:/run/app.sock"
+     */
+    std::string describe() const;
+};
+
+/**
+ * @class Listener
+ * @brief A bound, listening socket for one Endpoint
+ *
+ * The socket is non-blocking so an accept loop can drain every pending
+ * connection after a single poll() wakeup.
+ */
+class Listener {
+public:
+    /**
+     * @brief Create, configure, bind and listen
+     * @param endpoint The endpoint to serve
+     * @throws std::runtime_error If any step fails, or a live Unix socket is in the way
+     */
+    explicit Listener(const Endpoint& endpoint);
+
+    /**
+     * @brief Close the socket and remove a Unix socket file
+     */
+    ~Listener();
+
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    /**
+     * @brief Accept one pending connection
+     * @return A blocking, close-on-exec client socket, or -1 (errno EAGAIN when none is pending)
+     */
+    int accept();
+
+    int fd() const { return fd_; }
+    const Endpoint& endpoint() const { return endpoint_; }
+
+    /**
+     * @brief The port actually bound, which differs from the endpoint's when it asked for 0
+     * @return The TCP port, or 0 for Unix sockets
+     */
+    int bound_port() const { return bound_port_; }
+
+private:
+    Endpoint endpoint_;
+    int fd_ = -1;
+    int bound_port_ = 0;
+};
+
+} // namespace cppweb::net
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Opaque OpenSSL types, so including this header does not pull in OpenSSL
+struct ssl_st;
+struct ssl_ctx_st;
+
+namespace cppweb::net {
+
+/**
+ * @brief TLS settings for a server
+ */
+struct TlsConfig {
+    std::string cert_file;                              // PEM certificate chain
+    std::string key_file;                               // PEM private key
+    std::string ciphers;                                // TLS 1.2 cipher list; empty keeps OpenSSL's default
+    std::vector<std::string> alpn = {"h2", "http/1.1"}; // in order of preference
+    size_t session_cache_size = 20480;                  // sessions kept for resumption by session id
+    std::chrono::seconds session_timeout{300};
+    bool session_tickets = true;                        // stateless resumption
+    bool enable_ktls = true;                            // hand record encryption to the kernel when possible
+    std::chrono::milliseconds handshake_timeout{10000};   // whole handshake, however slowly the client sends
+};
+
+class TlsTransport;
+
+/**
+ * @class TlsContext
+ * @brief Certificate, session cache and protocol settings shared by all TLS connections
+ *
+ * One context serves every worker thread. The server-side session cache and
+ * the ticket keys live here, so a client can resume its session no matter
+ * which worker accepts the next connection.
+ */
+class TlsContext {
+public:
+    /**
+     * @brief Load the certificate and key and set up the context
+     * @param config The TLS settings
+     * @throws std::runtime_error If the certificate or key cannot be loaded
+     */
+    explicit TlsContext(const TlsConfig& config);
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    /**
+     * @brief Run the server handshake on an accepted socket
+     * @param fd The connected socket; not owned
+     * @param allow_h2 Whether "h2" may be selected through ALPN
+     * @return The established transport, or nullptr if the handshake failed
+     */
+    std::unique_ptr<TlsTransport> accept(int fd, bool allow_h2 = true);
+
+    uint64_t handshakes() const { return handshake_count.load(std::memory_order_relaxed); }
+    uint64_t resumed_sessions() const { return resumed_count.load(std::memory_order_relaxed); }
+    uint64_t failed_handshakes() const { return failed_count.load(std::memory_order_relaxed); }
+    uint64_t ktls_connections() const { return ktls_count.load(std::memory_order_relaxed); }
+
+private:
+    ssl_ctx_st* ctx = nullptr;
+    TlsConfig config;
+    std::string alpn_wire;      // config.alpn in ALPN wire format
+    std::string alpn_wire_h1;   // the same without "h2"
+
+    std::atomic<uint64_t> handshake_count{0};
+    std::atomic<uint64_t> resumed_count{0};
+    std::atomic<uint64_t> failed_count{0};
+    std::atomic<uint64_t> ktls_count{0};
+
+    static int select_alpn(ssl_st* ssl, const unsigned char** out, unsigned char* outlen,
+                           const unsigned char* in, unsigned int inlen, void* arg);
+};
+
+/**
+ * @class TlsTransport
+ * @brief One TLS connection
+ *
+ * When kernel TLS is active for sending, file bodies go through
+ * SSL_sendfile() and are encrypted in the kernel without being copied into
+ * userspace; otherwise they are read and encrypted in chunks. Mapped file
+ * segments are sent the same way, from the file.
+ */
+class TlsTransport : public Transport {
+public:
+    TlsTransport(int fd, ssl_st* ssl);
+    ~TlsTransport() override;
+
+    TlsTransport(const TlsTransport&) = delete;
+    TlsTransport& operator=(const TlsTransport&) = delete;
+
+    ssize_t read(void* buffer, size_t len) override;
+    ssize_t write(const void* data, size_t len) override;
+    ssize_t writev(const iovec* iov, int count) override;
+    ssize_t send_file(int file_fd, off_t offset, size_t count) override;
+
+    bool has_buffered_input() const override;
+    std::string negotiated_protocol() const override;
+    bool is_secure() const override { return true; }
+    bool writes_mapped_memory() const override { return false; }
+
+    /**
+     * @brief Whether the kernel encrypts outgoing records for this connection
+     */
+    bool ktls_send() const { return ktls_send_enabled; }
+
+    /**
+     * @brief Whether the handshake resumed an earlier session
+     */
+    bool session_reused() const;
+
+private:
+    ssl_st* ssl;
+    bool ktls_send_enabled = false;
+    bool failed = false;
+};
+
+} // namespace cppweb::net
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cppweb::net {
+
+/**
+ * @brief The file a mapped buffer can be read from; fd is -1 for plain memory
+ */
+struct FileSource {
+    int fd = -1;
+    uint64_t offset = 0;
+};
+
+/**
+ * @class Transport
+ * @brief Byte stream over an accepted connection
+ *
+ * Lets the HTTP/1.1 and HTTP/2 code run unchanged over plain TCP and TLS.
+ * The socket descriptor is not owned; the caller closes it after the
+ * transport is destroyed.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Read up to len bytes
+     * @return Bytes read, 0 on orderly close, or -1 on error; on a non-blocking
+     *         socket with nothing to return yet, -1 with errno set to EAGAIN
+     */
+    virtual ssize_t read(void* buffer, size_t len) = 0;
+
+    /**
+     * @brief Write up to len bytes
+     * @return Bytes written, or -1 on error
+     */
+    virtual ssize_t write(const void* data, size_t len) = 0;
+
+    /**
+     * @brief Write from several buffers with one call
+     *
+     * The default gathers up to 16 KB of the buffers into one write(), which
+     * for TLS fills a whole record.
+     * @return Bytes written, or -1 on error
+     */
+    virtual ssize_t writev(const iovec* iov, int count);
+
+    /**
+     * @brief Send part of a file without staging it in a user buffer where possible
+     * @param file_fd Descriptor of the file to send
+     * @param offset Offset to start at
+     * @param count Maximum number of bytes to send
+     * @return Bytes sent, or -1 on error
+     */
+    virtual ssize_t send_file(int file_fd, off_t offset, size_t count) = 0;
+
+    /**
+     * @brief Whether bytes are already buffered and read() will not block
+     *
+     * poll() on the socket cannot see data a TLS layer has decrypted but
+     * not yet returned.
+     */
+    virtual bool has_buffered_input() const { return false; }
+
+    /**
+     * @brief Protocol agreed during connection setup ("h2", "http/1.1"), or empty
+     */
+    virtual std::string negotiated_protocol() const { return ""; }
+
+    /**
+     * @brief Whether this transport encrypts traffic
+     */
+    virtual bool is_secure() const { return false; }
+
+    /**
+     * @brief Whether buffers backed by a file mapping can be written directly
+     *
+     * A socket write copies them in the kernel, which turns a page lost to
+     * truncation into an error. A transport that copies them in user space
+     * would take SIGBUS instead, so it reads the file.
+     */
+    virtual bool writes_mapped_memory() const { return true; }
+
+    /**
+     * @brief The underlying socket descriptor
+     */
+    int fd() const { return fd_; }
+
+    /**
+     * @brief Write all of data, retrying partial writes
+     * @return True if every byte was written
+     */
+    bool write_all(const void* data, size_t len);
+
+    /**
+     * @brief Write every byte of several buffers, retrying partial writes
+     * @param iov The buffers; entries are advanced in place as bytes are sent
+     * @param count Number of entries
+     * @return True if every byte was written
+     */
+    bool writev_all(iovec* iov, size_t count);
+
+    /**
+     * @brief writev_all() for buffers of which some map a file
+     *
+     * If the transport cannot write mapped memory, each buffer with a file
+     * source is sent from its file instead, in order with the others.
+     * @param files One entry per buffer
+     * @return True if every byte was written
+     */
+    bool writev_all(iovec* iov, const FileSource* files, size_t count);
+
+    /**
+     * @brief Send count bytes of a file starting at offset
+     * @return Bytes actually sent; less than count on error
+     */
+    uint64_t send_file_all(int file_fd, off_t offset, uint64_t count);
+
+protected:
+    explicit Transport(int fd) : fd_(fd) {}
+
+private:
+    int fd_;
+};
+
+/**
+ * @class PlainTransport
+ * @brief Unencrypted TCP or Unix socket; files go through sendfile(2), buffers through sendmsg(2)
+ */
+class PlainTransport : public Transport {
+public:
+    explicit PlainTransport(int fd) : Transport(fd) {}
+
+    ssize_t read(void* buffer, size_t len) override;
+    ssize_t write(const void* data, size_t len) override;
+    ssize_t writev(const iovec* iov, int count) override;
+    ssize_t send_file(int file_fd, off_t offset, size_t count) override;
+};
+
+/**
+ * @brief Copy a file range through a user buffer with pread() and write()
+ *
+ * Fallback for transports and files that cannot use sendfile.
+ * @return Bytes sent, or -1 if nothing could be sent
+ */
+ssize_t send_file_buffered(Transport& transport, int file_fd, off_t offset, size_t count);
+
+} // namespace cppweb::net
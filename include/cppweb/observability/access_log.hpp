@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "thread_slots.hpp"
+
+namespace cppweb::observability {
+
+/**
+ * @brief Output line formats understood by AccessLog
+ */
+enum class AccessLogFormat {
+    Common,    // NCSA common log format
+    Combined,  // common + referer and user agent
+    JsonLines  // one JSON object per line
+};
+
+/**
+ * @brief Access log settings
+ */
+struct AccessLogConfig {
+    AccessLogFormat format = AccessLogFormat::Combined;
+    std::string path;                               // file to append to; empty logs to stderr
+    size_t ring_capacity = 4096;                    // records buffered per worker thread
+    size_t write_buffer_bytes = 256 * 1024;         // formatted bytes collected before each write
+    std::chrono::milliseconds flush_interval{100};  // longest time a record waits to be written
+};
+
+/**
+ * @brief One request as seen by the access log
+ *
+ * Fixed-size so it can be copied into a ring slot without allocating;
+ * string fields are NUL-terminated and truncated to fit.
+ */
+struct AccessRecord {
+    int64_t timestamp_us = 0; // wall clock, microseconds since the Unix epoch
+    uint64_t latency_ns = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    int status_code = 0;
+    char method[12] = {};
+    char protocol[12] = {};
+    char remote[48] = {};
+    char path[160] = {};
+    char referer[128] = {};
+    char user_agent[160] = {};
+
+    /**
+     * @brief Copy a string into one of the fixed-size fields
+     */
+    template<size_t N>
+    static void set(char (&field)[N], const std::string& value) {
+        size_t len = value.size() < N - 1 ? value.size() : N - 1;
+        value.copy(field, len);
+        field[len] = '\0';
+    }
+};
+
+/**
+ * @class AccessLog
+ * @brief Asynchronous access log fed through per-thread SPSC rings
+ *
+ * Request threads copy a fixed-size record into their own ring and return;
+ * apart from claiming that ring on a thread's first record they never take a
+ * lock or touch the output stream. Waking the writer is an atomic increment
+ * plus a futex wake when it sleeps. A background thread drains all rings,
+ * formats records in batches and writes them out with large buffered writes.
+ * When a ring is full the record is dropped and counted. A ring whose thread
+ * has exited is taken over by the next new thread.
+ */
+class AccessLog {
+public:
+    /**
+     * @brief Open the log destination and start the writer thread
+     * @param config The log settings
+     * @throws std::runtime_error If the log file cannot be opened
+     */
+    explicit AccessLog(AccessLogConfig config = AccessLogConfig());
+
+    /**
+     * @brief Drain every ring, flush, and stop the writer thread
+     */
+    ~AccessLog();
+
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    /**
+     * @brief Queue a record without blocking
+     * @param record The record to log
+     * @return False if the calling thread's ring was full and the record was dropped
+     */
+    bool log(const AccessRecord& record);
+
+    /**
+     * @brief Number of records dropped because a ring was full
+     */
+    uint64_t dropped() const;
+
+    /**
+     * @brief Number of records written to the destination
+     */
+    uint64_t written() const { return written_count.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of records lost because writing their batch to the destination failed
+     */
+    uint64_t failed() const { return failed_count.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of per-thread rings allocated so far
+     */
+    size_t ring_count() const { return rings.size(); }
+
+    /**
+     * @brief Append one formatted line for a record
+     * @param record The record to format
+     * @param format The line format
+     * @param out The string the line (including its newline) is appended to
+     */
+    static void format_record(const AccessRecord& record, AccessLogFormat format, std::string& out);
+
+private:
+    class Ring;
+
+    const AccessLogConfig config;
+    int fd = -1;
+    bool owns_fd = false;
+
+    ThreadSlots<Ring> rings;
+
+    std::atomic<uint32_t> wake_seq{0};         // bumped to wake the writer, which sleeps on it
+    std::atomic<bool> writer_sleeping{false};  // producers only make the wake syscall when set
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> written_count{0};
+    std::atomic<uint64_t> failed_count{0};
+    std::thread writer;
+
+    Ring& local_ring();
+    void wake_writer();
+    void writer_loop();
+    size_t drain(std::string& buffer, size_t& buffered);
+    void write_out(std::string& buffer, size_t& buffered);
+};
+
+} // namespace cppweb::observability
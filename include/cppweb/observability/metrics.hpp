@@ -0,0 +1,249 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "thread_slots.hpp"
+
+namespace cppweb::observability {
+
+/**
+ * @brief Monotonic timestamp in nanoseconds
+ * @return Nanoseconds since an arbitrary, steady epoch
+ */
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * @class LatencyHistogram
+ * @brief HDR-style log-linear histogram of nanosecond durations
+ *
+ * Every power of two is split into 16 linear sub-buckets, so any recorded
+ * value is known to within ~6% while the whole range (1ns to ~68s) fits in a
+ * fixed array. Recording is a couple of bit operations and one increment.
+ * Instances are not synchronized; callers own the locking.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr unsigned kMaxValueBits = 36;
+    static constexpr size_t kSubBucketCount = size_t(1) << kSubBucketBits;
+    static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+    /**
+     * @brief Record a duration, clamping values beyond the tracked range
+     * @param value_ns The duration in nanoseconds
+     */
+    void record(uint64_t value_ns);
+
+    /**
+     * @brief Add all samples of another histogram into this one
+     * @param other The histogram to merge
+     */
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return total_count; }
+    uint64_t sum() const { return total_sum; }
+
+    /**
+     * @brief Number of samples whose bucket lies entirely at or below a bound
+     * @param bound_ns The upper bound in nanoseconds
+     */
+    uint64_t count_at_or_below(uint64_t bound_ns) const;
+
+    /**
+     * @brief Estimate a percentile
+     * @param percentile Value in [0, 100]
+     * @return The upper bound of the bucket containing the percentile, or 0 if empty
+     */
+    uint64_t percentile(double percentile) const;
+
+    static size_t bucket_index(uint64_t value_ns);
+    static uint64_t bucket_lower_bound(size_t index);
+    static uint64_t bucket_upper_bound(size_t index);
+
+private:
+    std::array<uint64_t, kBucketCount> buckets{};
+    uint64_t total_count = 0;
+    uint64_t total_sum = 0;
+};
+
+/**
+ * @brief Request methods that get their own metrics label
+ *
+ * The method comes from the client, so anything else is folded into Other
+ * to keep the number of label values bounded.
+ */
+enum class HttpMethod : uint8_t {
+    Get,
+    Head,
+    Post,
+    Put,
+    Delete,
+    Patch,
+    Options,
+    Other
+};
+
+constexpr size_t kHttpMethodCount = static_cast<size_t>(HttpMethod::Other) + 1;
+
+/**
+ * @brief Map a request method to its label; comparison is case-sensitive
+ */
+HttpMethod classify_method(const std::string& method);
+
+/**
+ * @brief The label exported for a method, e.g. "GET" or "OTHER"
+ */
+const char* method_label(HttpMethod method);
+
+/**
+ * @brief Counters and histograms kept for one method/route pair
+ */
+struct RouteStats {
+    uint64_t requests = 0;
+    std::array<uint64_t, 5> status_classes{}; // 1xx .. 5xx
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    LatencyHistogram handler_latency;
+    LatencyHistogram total_latency;
+
+    void merge(const RouteStats& other);
+};
+
+/**
+ * @brief Everything known about one completed request
+ *
+ * The connection's queue wait and its close ride along with the request
+ * that ends it, so an HTTP/1.1 exchange costs a single shard update.
+ */
+struct RequestSample {
+    const std::string& method;
+    const std::string& route;
+    int status_code;
+    uint64_t handler_ns;
+    uint64_t total_ns;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    const uint64_t* queue_wait_ns; // recorded as well when not null
+    bool connection_closed;        // counts the connection as closed
+};
+
+/**
+ * @brief Merged view over all per-thread shards at one point in time
+ */
+struct MetricsSnapshot {
+    std::map<std::string, std::map<std::string, RouteStats>> routes; // method label -> route -> stats
+    LatencyHistogram queue_wait;
+    uint64_t connections_opened = 0;
+    uint64_t connections_closed = 0;
+    size_t queue_depth = 0;
+    size_t worker_count = 0;
+    uint64_t workers_started = 0; // by an elastic pool growing
+    uint64_t workers_retired = 0; // by an elastic pool shrinking
+
+    uint64_t active_connections() const {
+        return connections_opened >= connections_closed ? connections_opened - connections_closed : 0;
+    }
+};
+
+/**
+ * @class MetricsRegistry
+ * @brief Low-overhead request instrumentation with per-thread shards
+ *
+ * Each recording thread writes into its own shard, guarded by a mutex that is
+ * only ever contended while a snapshot is being taken. A shard is handed to
+ * the next new thread once its own exits, so totals never go backwards and
+ * an elastic pool does not grow one shard per worker it ever started;
+ * snapshot() merges them on read.
+ * Accepted connections are the exception: the accept loop counts them with
+ * one atomic increment instead of a shard of its own.
+ */
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /**
+     * @brief Record a completed request
+     * @param sample The request's route, status, timings and sizes
+     */
+    void record_request(const RequestSample& sample);
+
+    /**
+     * @brief Record how long a task waited in the thread pool queue
+     * @param wait_ns The wait in nanoseconds
+     */
+    void record_queue_wait(uint64_t wait_ns);
+
+    void connection_opened();
+    void connection_closed();
+
+    /**
+     * @brief Record a connection that closes without a request to carry its metrics
+     * @param queue_wait_ns Its queue wait, or null if already recorded
+     */
+    void connection_closed(const uint64_t* queue_wait_ns);
+
+    /**
+     * @brief Record an elastic pool changing its worker count
+     * @param old_count Workers before the change
+     * @param new_count Workers after the change
+     */
+    void record_pool_resize(size_t old_count, size_t new_count);
+
+    /**
+     * @brief Install callbacks sampled at snapshot time for pool gauges
+     * @param queue_depth Returns the number of queued tasks
+     * @param worker_count Returns the number of worker threads
+     */
+    void set_pool_probes(std::function<size_t()> queue_depth, std::function<size_t()> worker_count);
+
+    /**
+     * @brief Merge all shards into a consistent snapshot
+     */
+    MetricsSnapshot snapshot() const;
+
+    /**
+     * @brief Render the current snapshot in the Prometheus text exposition format
+     */
+    std::string render_prometheus() const;
+
+    /**
+     * @brief Number of per-thread shards allocated so far
+     */
+    size_t shard_count() const;
+
+private:
+    struct ThreadShard {
+        std::mutex mutex;
+        std::array<std::unordered_map<std::string, RouteStats>, kHttpMethodCount> routes;
+        LatencyHistogram queue_wait;
+        uint64_t connections_closed = 0;
+        uint64_t workers_started = 0;
+        uint64_t workers_retired = 0;
+    };
+
+    std::atomic<uint64_t> connections_opened{0};
+    ThreadSlots<ThreadShard> shards;
+    mutable std::mutex probes_mutex;
+    std::function<size_t()> queue_depth_probe;
+    std::function<size_t()> worker_count_probe;
+
+    ThreadShard& local_shard();
+};
+
+} // namespace cppweb::observability
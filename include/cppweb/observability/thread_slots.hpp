@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cppweb::observability {
+
+/**
+ * @class ThreadSlots
+ * @brief Per-thread objects (metrics shards, rings) that are reused after their thread exits
+ *
+ * Each thread that calls local() gets a slot of its own and keeps it until
+ * it exits. The slot then goes on a free list and the next new thread takes
+ * it over together with whatever it holds, so counters never go backwards
+ * and queued records are not lost. The number of slots is bounded by the
+ * most threads ever using the owner at the same time, however many threads
+ * come and go.
+ *
+ * local() takes no lock once the calling thread has its slot. Slots are
+ * freed together with the ThreadSlots, even while threads still hold them.
+ */
+template<typename Slot>
+class ThreadSlots {
+public:
+    ThreadSlots() : state(std::make_shared<State>()) {}
+
+    ThreadSlots(const ThreadSlots&) = delete;
+    ThreadSlots& operator=(const ThreadSlots&) = delete;
+
+    /**
+     * @brief The calling thread's slot
+     * @param make Creates a slot when no freed one is available; called under the lock
+     */
+    template<typename Make>
+    Slot& local(Make&& make) {
+        std::vector<Lease>& leases = thread_leases();
+        for (const auto& lease : leases) {
+            if (lease.id == state->id) {
+                return *lease.slot;
+            }
+        }
+
+        Slot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            if (!state->free.empty()) {
+                slot = state->free.back();
+                state->free.pop_back();
+            } else {
+                state->slots.push_back(make(state->slots.size()));
+                slot = state->slots.back().get();
+            }
+        }
+        leases.emplace_back(state, slot);
+        return *slot;
+    }
+
+    /**
+     * @brief Call fn for every slot, in use or free, while holding the lock
+     */
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        for (const auto& slot : state->slots) {
+            fn(*slot);
+        }
+    }
+
+    /**
+     * @brief Number of slots ever created
+     */
+    size_t size() const {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        return state->slots.size();
+    }
+
+private:
+    struct State {
+        // Ids are never reused, so a lease left behind by a destroyed owner
+        // can never be matched again
+        const uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<Slot*> free;
+    };
+
+    // Held in the thread's cache; gives the slot back when the thread exits
+    struct Lease {
+        uint64_t id;
+        Slot* slot;
+        std::weak_ptr<State> owner;
+
+        Lease(const std::shared_ptr<State>& state, Slot* slot) : id(state->id), slot(slot), owner(state) {}
+        Lease(Lease&&) = default;
+
+        ~Lease() {
+            // Moved-from leases and leases of a destroyed owner have nothing to return
+            if (auto state = owner.lock()) {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->free.push_back(slot);
+            }
+        }
+    };
+
+    static inline std::atomic<uint64_t> next_id{1};
+
+    // One cache per slot type, shared by every owner of that type
+    static std::vector<Lease>& thread_leases() {
+        thread_local std::vector<Lease> leases;
+        return leases;
+    }
+
+    std::shared_ptr<State> state;
+};
+
+} // namespace cppweb::observability
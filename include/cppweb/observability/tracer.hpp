@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "thread_slots.hpp"
+
+namespace cppweb::observability {
+
+/**
+ * @brief The stages a request passes through inside the server
+ */
+enum class TracePhase : uint8_t {
+    Accept,     // accept() returned until the connection was queued
+    QueueWait,  // waiting in the thread pool queue
+    Read,       // reading the request off the socket
+    Parse,      // parse_request
+    Handler,    // route handler execution
+    Send,       // writing the response
+    Request     // the whole request, accept to last byte sent
+};
+
+/**
+ * @brief Get a printable name for a trace phase
+ */
+const char* trace_phase_name(TracePhase phase);
+
+/**
+ * @brief One recorded span
+ */
+struct TraceEvent {
+    static constexpr size_t kLabelSize = 48;
+
+    uint64_t request_id = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
+    TracePhase phase = TracePhase::Request;
+    int status_code = 0;
+    uint32_t thread_index = 0;
+    char label[kLabelSize] = {}; // NUL-terminated, truncated "METHOD /path"
+};
+
+/**
+ * @class Tracer
+ * @brief Opt-in sampling tracer for per-request phase timings
+ *
+ * Each recording thread owns a fixed-size ring buffer that it writes without
+ * locks; old events are overwritten once the ring is full. Readers copy events
+ * out under a per-slot sequence check, so dumping never blocks the writers.
+ * A ring whose thread has exited is taken over by the next new thread, events
+ * and thread_index included.
+ * With a sample rate of zero the only cost per request is one relaxed load.
+ */
+class Tracer {
+public:
+    /**
+     * @brief Constructor
+     * @param ring_capacity Events kept per thread, rounded up to a power of two
+     */
+    explicit Tracer(size_t ring_capacity = 4096);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @brief Set the fraction of requests to trace
+     * @param rate Value in [0, 1]; 0 disables tracing
+     */
+    void set_sample_rate(double rate);
+    double get_sample_rate() const;
+
+    /**
+     * @brief Decide whether to trace a new request
+     * @return A non-zero request id if the request is sampled, 0 otherwise
+     */
+    uint64_t sample();
+
+    /**
+     * @brief Record a span into the calling thread's ring
+     * @param request_id The id returned by sample(); 0 is ignored
+     * @param phase The phase the span covers
+     * @param start_ns Monotonic start timestamp
+     * @param end_ns Monotonic end timestamp
+     * @param label Optional label, truncated to fit the fixed-size record
+     * @param status_code Optional response status
+     */
+    void record(uint64_t request_id, TracePhase phase, uint64_t start_ns, uint64_t end_ns,
+                const std::string& label = std::string(), int status_code = 0);
+
+    /**
+     * @brief Copy out all events currently held in the rings
+     */
+    std::vector<TraceEvent> collect() const;
+
+    /**
+     * @brief Write all held events in the Chrome Trace Event / Perfetto JSON format
+     * @param out The stream to write to
+     */
+    void write_chrome_json(std::ostream& out) const;
+
+    /**
+     * @brief Render all held events as a Chrome Trace Event JSON document
+     */
+    std::string export_chrome_json() const;
+
+    /**
+     * @brief Number of per-thread rings allocated so far
+     */
+    size_t ring_count() const;
+
+private:
+    class Ring;
+
+    const size_t ring_capacity;
+    std::atomic<uint64_t> sample_threshold{0};
+    std::atomic<uint64_t> next_request_id{1};
+    ThreadSlots<Ring> rings;
+
+    Ring& local_ring();
+};
+
+} // namespace cppweb::observability
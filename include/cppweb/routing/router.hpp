@@ -6,6 +6,8 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
 
 namespace cppweb {
 
@@ -28,8 +30,8 @@ namespace cppweb {
         // Register DELETE route
         void del(const std::string& path, RouteHandler handler);
 
-        // Route a request and generate a response
-        void route(const Request& req, Response& res) const;
+        // Route a request and generate a response; returns false if no route matched
+        bool route(const Request& req, Response& res) const;
 
         // Check if a route exists
         bool has_route(const std::string& method, const std::string& path) const;
@@ -37,11 +39,18 @@ namespace cppweb {
         // Get total number of registered routes
         size_t route_count() const;
 
+        // Run a route's handler on the named executor; an empty name clears the assignment
+        void set_executor(const std::string& method, const std::string& path, const std::string& executor);
+
+        // Name of the executor assigned to a route, or empty if it has none
+        std::string executor_for(const std::string& method, const std::string& path) const;
+
     private:
         std::map<std::string, RouteHandler> get_routes;
         std::map<std::string, RouteHandler> post_routes;
         std::map<std::string, RouteHandler> put_routes;
         std::map<std::string, RouteHandler> delete_routes;
+        std::map<std::pair<std::string, std::string>, std::string> route_executors; // (method, path) -> executor
         mutable std::mutex routes_mutex;
 
         std::map<std::string, RouteHandler>& get_route_map(const std::string& method);
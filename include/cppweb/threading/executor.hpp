@@ -0,0 +1,138 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cppweb {
+namespace threading {
+
+    /**
+     * @brief What an Executor does with a task when its queue is full
+     */
+    enum class QueueFullPolicy {
+        Reject,     // refuse the task; the server answers 503 Service Unavailable
+        Block,      // park the task up to block_timeout for a queue slot, then reject
+        CallerRuns  // run the task on the submitting thread
+    };
+
+    /**
+     * @brief Sizing and overload behaviour of an Executor
+     */
+    struct ExecutorOptions {
+        size_t threads = 4;
+        size_t max_queue = 256;  // tasks waiting for a worker, not counting running ones
+        QueueFullPolicy when_full = QueueFullPolicy::Reject;
+        std::chrono::milliseconds block_timeout{1000};
+    };
+
+    /**
+     * @brief Counters describing an Executor's activity
+     */
+    struct ExecutorStats {
+        size_t threads = 0;
+        size_t queued = 0;
+        size_t waiting = 0; // parked by the Block policy until a slot frees
+        uint64_t submitted = 0;
+        uint64_t rejected = 0;
+        uint64_t ran_on_caller = 0;
+    };
+
+    /**
+     * @class Executor
+     * @brief A named worker pool with a bounded queue
+     *
+     * Routes assigned to an executor run on its workers only, so a slow
+     * endpoint can exhaust its own executor without delaying routes served
+     * elsewhere (the bulkhead pattern).
+     */
+    class Executor {
+    public:
+        /**
+         * @brief Name of the built-in executor that runs handlers on the
+         *        connection's own thread without a hand-off
+         */
+        static constexpr const char* kInline = "inline";
+
+        enum class Admission { Queued, CallerRuns, Rejected };
+
+        /**
+         * @param name Name used to assign routes to this executor
+         * @param options Thread count, queue limit and queue-full policy
+         * @throws std::invalid_argument If threads is 0
+         */
+        Executor(std::string name, const ExecutorOptions& options);
+
+        /**
+         * @brief Join the workers; parked tasks are dropped without running
+         */
+        ~Executor();
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        /**
+         * @brief Offer a task to the executor
+         *
+         * Under the Block policy a task that finds the queue full is parked
+         * instead of holding the caller: it moves into the queue when a slot
+         * frees, or on_timeout runs on the executor's timer thread once
+         * block_timeout has passed. At most max_queue tasks are parked; more
+         * are rejected at once. Without on_timeout the caller waits for the
+         * slot itself.
+         * @param task The work to run on a worker
+         * @param on_timeout Answers for a parked task that never got a slot
+         * @return Queued if a worker will run it, or it was parked; CallerRuns
+         *         if the caller must run it itself; Rejected if it must not run
+         */
+        Admission submit(std::function<void()> task, std::function<void()> on_timeout = nullptr);
+
+        const std::string& name() const { return name_; }
+        const ExecutorOptions& options() const { return options_; }
+
+        ExecutorStats stats() const;
+
+    private:
+        const std::string name_;
+        const ExecutorOptions options_;
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Parked {
+            std::function<void()> task;
+            std::function<void()> on_timeout;
+            Clock::time_point deadline;
+        };
+
+        mutable std::mutex mutex;
+        std::condition_variable slot_freed;
+        size_t queued = 0;
+
+        // Oldest first; with one block_timeout, that is also the earliest deadline
+        std::deque<Parked> parked;
+        std::condition_variable parked_changed;
+        bool stopping = false;
+        std::thread timer; // only for the Block policy
+
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> ran_on_caller{0};
+
+        // Declared last so its workers are joined before the state above goes away
+        std::unique_ptr<ThreadPool> pool;
+
+        void start(std::function<void()> task);
+        void release_slot();
+        void expire_parked();
+    };
+
+} // namespace threading
+} // namespace cppweb
@@ -2,21 +2,74 @@
 
 #include <thread>
 #include <mutex>
-#include <queue>
+#include <deque>
 #include <condition_variable>
 #include <vector>
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
 namespace cppweb {
 namespace threading {
+
+    /**
+     * @brief Sizing policy for an elastic ThreadPool
+     *
+     * The pool keeps at least min_threads workers. While queued tasks wait
+     * longer than target_queue_wait and no worker is idle, it adds workers up
+     * to max_threads; a worker that stays idle for idle_timeout retires again.
+     */
+    struct PoolOptions {
+        size_t min_threads = 4;
+        size_t max_threads = 64;
+        std::chrono::milliseconds target_queue_wait{10};
+        std::chrono::milliseconds idle_timeout{30000};
+
+        // Called with the old and new worker count after every resize. It may be
+        // called from a worker or the pool's supervisor thread, so keep it short.
+        std::function<void(size_t old_count, size_t new_count)> on_resize;
+    };
+
+    /**
+     * @brief Counters describing a pool's activity
+     */
+    struct PoolStats {
+        size_t threads = 0;
+        size_t idle_threads = 0;
+        size_t queued_tasks = 0;
+        size_t min_threads = 0;
+        size_t max_threads = 0;
+        uint64_t threads_started = 0;  // beyond the initial min_threads
+        uint64_t threads_retired = 0;
+    };
+
     class ThreadPool {
     public:
+        /**
+         * @brief Fixed-size pool
+         * @param num_threads Number of workers, kept for the pool's lifetime
+         */
         explicit ThreadPool(size_t num_threads = 4);
 
+        /**
+         * @brief Elastic pool resized between options.min_threads and options.max_threads
+         * @throws std::invalid_argument If the bounds are empty or inverted
+         */
+        explicit ThreadPool(const PoolOptions& options);
+
         ~ThreadPool();
 
+        /**
+         * @brief Stop accepting tasks, run the ones already queued and join the workers
+         *
+         * enqueue() throws from then on. Safe to call more than once; the
+         * destructor calls it.
+         */
+        void shutdown();
+
         template<typename F>
         void enqueue(F&& func) {
             {
@@ -24,21 +77,55 @@ namespace threading {
                 if (stop) {
                     throw std::runtime_error("Cannot enqueue task on stopped thread pool");
                 }
-                task_queue.emplace(std::forward<F>(func));
+                task_queue.push_back({std::function<void()>(std::forward<F>(func)),
+                                      elastic ? std::chrono::steady_clock::now()
+                                              : std::chrono::steady_clock::time_point()});
             }
             condition.notify_one();
         }
 
-        size_t get_thread_count() const { return workers.size(); }
+        size_t get_thread_count() const { return thread_count.load(std::memory_order_relaxed); }
+
+        size_t get_queue_size() const {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            return task_queue.size();
+        }
+
+        bool is_elastic() const { return elastic; }
+
+        /**
+         * @brief Current size, bounds and resize counters
+         */
+        PoolStats get_stats() const;
 
     private:
+        struct Task {
+            std::function<void()> func;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        PoolOptions options;
+        const bool elastic;
+
         std::vector<std::thread> workers;
-        std::queue<std::function<void()>> task_queue;
-        std::mutex queue_mutex;
+        std::vector<std::thread::id> exited;  // retired workers waiting to be joined
+        std::deque<Task> task_queue;
+        mutable std::mutex queue_mutex;
         std::condition_variable condition;
+        std::condition_variable supervisor_wakeup;
+        std::thread supervisor;
         bool stop = false;
 
+        std::atomic<size_t> thread_count{0};
+        size_t idle_threads = 0;
+        uint64_t threads_started = 0;
+        uint64_t threads_retired = 0;
+
+        void start_worker();
         void worker_thread();
+        void supervise();
+        std::vector<std::thread> take_exited();
+        void notify_resize(size_t old_count, size_t new_count);
     };
 
 } // namespace threading
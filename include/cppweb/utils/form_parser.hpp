@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../core/request.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cppweb::utils {
+
+/**
+ * @brief Size limits applied while parsing a form body
+ */
+struct FormLimits {
+    size_t max_parts = 128;
+    size_t max_part_headers = 8 * 1024;        // header block of one multipart part
+    size_t max_field_size = 1024 * 1024;       // a non-file field, kept in memory
+    size_t max_file_size = 256 * 1024 * 1024;  // one uploaded file
+    size_t spill_threshold = 64 * 1024;        // file parts larger than this move to a temp file
+    std::string temp_dir;                      // empty uses $TMPDIR, then /tmp
+};
+
+/**
+ * @class FormParser
+ * @brief Incremental parser for multipart/form-data and x-www-form-urlencoded bodies
+ *
+ * The body can be fed in chunks of any size as it arrives from the socket,
+ * so it never has to be held in memory as a whole. Part delimiters are
+ * found with a Boyer-Moore-Horspool search, which skips most bytes of large
+ * binary parts. File parts that grow past spill_threshold are written to a
+ * temp file; everything else is kept in FormPart::data.
+ */
+class FormParser {
+public:
+    /**
+     * @brief Check whether a Content-Type is a form this parser understands
+     */
+    static bool accepts(const std::string& content_type);
+
+    /**
+     * @param content_type The request's Content-Type, including the multipart boundary
+     * @param limits Size limits
+     */
+    FormParser(const std::string& content_type, FormLimits limits = FormLimits());
+    ~FormParser();
+
+    FormParser(const FormParser&) = delete;
+    FormParser& operator=(const FormParser&) = delete;
+
+    /**
+     * @brief Parse the next chunk of the body
+     * @return False once the body is malformed or exceeds a limit; see error()
+     */
+    bool feed(const char* data, size_t len);
+
+    /**
+     * @brief Signal the end of the body
+     * @return False if the body was incomplete or invalid
+     */
+    bool finish();
+
+    /**
+     * @brief Move the parsed parts out of the parser
+     */
+    std::vector<FormPart> take_parts() { return std::move(parts); }
+
+    /**
+     * @brief Why parsing failed, or empty
+     */
+    const std::string& error() const { return error_message; }
+
+    /**
+     * @brief HTTP status to answer a failed parse with: 413 for limits, 400 otherwise
+     */
+    int error_status() const { return error_code; }
+
+private:
+    enum class State { Preamble, AfterDelimiter, Headers, Body, Epilogue, UrlEncoded, Failed };
+
+    FormLimits limits;
+    State state;
+    std::vector<FormPart> parts;
+    std::string error_message;
+    int error_code = 0;
+
+    // multipart: "\r\n--" + boundary, with its Horspool shift table
+    std::string delimiter;
+    size_t shift[256];
+
+    std::string buffer;     // bytes not consumed yet
+    size_t offset = 0;      // start of the unconsumed bytes in buffer
+    int spill_fd = -1;      // temp file of the current part, if spilled
+
+    // x-www-form-urlencoded: the field being accumulated
+    std::string pending_field;
+
+    bool fail(int status, const std::string& message);
+    size_t find_delimiter(size_t from) const;
+    bool parse_part_headers(const std::string& block);
+    bool append_to_part(const char* data, size_t len);
+    bool spill(FormPart& part);
+    void close_spill();
+    bool finish_url_field();
+    void compact();
+};
+
+/**
+ * @brief Decode a %XX- and '+'-encoded form component
+ */
+std::string url_decode(const std::string& value);
+
+} // namespace cppweb::utils
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <map>
 #include <string>
 #include "../core/request.hpp"
+#include "../core/response.hpp"
 
 namespace cppweb::utils {
+/**
+ * @brief Split a request target into its path and query parameters
+ * @param target The raw target, e.g. "/search?q=term&page=2"
+ * @param path Receives the part before '?'
+ * @param query_params Receives the key/value pairs after the '?'
+ */
+void split_request_target(const std::string& target, std::string& path,
+                          std::map<std::string, std::string>& query_params);
+
 /**
  * @brief Parse an HTTP request from raw data
  * @param raw_data The raw HTTP request string
@@ -11,4 +22,12 @@ namespace cppweb::utils {
  */
 Request parse_request(const std::string& raw_data);
 
+/**
+ * @brief Serialize the status line and headers of an HTTP response
+ * @param res The response to serialize
+ * @param content_length The value for the Content-Length header
+ * @return The response head, terminated by an empty line
+ */
+std::string format_response_head(const Response& res, size_t content_length);
+
 } // namespace cppweb::utils
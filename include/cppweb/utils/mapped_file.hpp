@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../core/response.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cppweb::utils {
+
+/**
+ * @class MappedFile
+ * @brief A file mapped read-only into memory, for use as a response body
+ *
+ * Segments handed out by segment() share ownership of the mapping, so the
+ * file stays mapped until the last response using it has been sent. Map a
+ * file once and serve it to any number of clients; the pages are shared
+ * with the page cache rather than copied per response.
+ *
+ * The file must not be modified while it is mapped: changes show up in
+ * responses already being sent, and reading a page that truncation removed
+ * raises SIGBUS. To replace a served file, write a new file and rename() it
+ * over the old one, then map it again. The descriptor stays open, so TLS
+ * connections read the file with pread() instead of touching the mapping,
+ * and a truncated file ends such a send with an error.
+ */
+class MappedFile : public std::enable_shared_from_this<MappedFile> {
+public:
+    /**
+     * @brief Map a whole file
+     * @param path The file to map
+     * @return The mapping
+     * @throws std::runtime_error If the file cannot be opened, is not a regular file, or cannot be mapped
+     */
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    int fd() const { return fd_; }
+
+    /**
+     * @brief A region of the file as a response body segment
+     * @param offset Start of the region, clamped to the file size
+     * @param length Length of the region; the default runs to the end of the file
+     */
+    BodySegment segment(size_t offset = 0, size_t length = std::string::npos) const;
+
+private:
+    MappedFile(int fd, const char* data, size_t size) : fd_(fd), data_(data), size_(size) {}
+
+    int fd_;
+    const char* data_;
+    size_t size_;
+};
+
+} // namespace cppweb::utils
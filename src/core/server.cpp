@@ -1,19 +1,24 @@
 #include "../../include/cppweb/core/server.hpp"
 #include "../../include/cppweb/utils/http_utils.hpp"
+#include "../../include/cppweb/utils/form_parser.hpp"
 #include "../../include/cppweb/utils/codes.hpp"
 #include "../../include/cppweb/utils/mime_type.hpp"
 #include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
-#include <sstream>
 #include <stdexcept>
-
-#ifndef MSG_NOSIGNAL
-#define MSG_NOSIGNAL 0
-#endif
+#include <cerrno>
+#include <chrono>
 
 namespace cppweb {
 
@@ -47,19 +52,172 @@ namespace {
     };
 }
 
+namespace {
+    std::string peer_address(int fd) {
+        sockaddr_storage addr{};
+        socklen_t len = sizeof(addr);
+        if (getpeername(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+            return "";
+        }
+
+        char text[INET6_ADDRSTRLEN] = {};
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(&addr)->sin_addr, text, sizeof(text));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(&addr)->sin6_addr, text, sizeof(text));
+        }
+        return text;
+    }
+
+    // Case-insensitive lookup in a raw HTTP/1.1 header block ending at header_end
+    std::string raw_header_value(const std::string& raw, size_t header_end, const char* lower_name) {
+        size_t name_len = std::strlen(lower_name);
+        size_t pos = raw.find("\r\n");
+        while (pos != std::string::npos && pos < header_end) {
+            size_t line = pos + 2;
+            size_t eol = raw.find("\r\n", line);
+            if (eol == std::string::npos || eol > header_end) eol = header_end;
+            if (eol - line > name_len && raw[line + name_len] == ':') {
+                bool same = true;
+                for (size_t i = 0; i < name_len && same; ++i) {
+                    same = std::tolower(static_cast<unsigned char>(raw[line + i])) == lower_name[i];
+                }
+                if (same) {
+                    size_t value = raw.find_first_not_of(" \t", line + name_len + 1);
+                    return value < eol ? raw.substr(value, raw.find_last_not_of(" \t", eol - 1) + 1 - value) : "";
+                }
+            }
+            pos = eol;
+        }
+        return "";
+    }
+
+    std::string header_value(const Request& req, const std::string& name, const std::string& lower_name) {
+        auto it = req.headers.find(name);
+        if (it == req.headers.end()) {
+            it = req.headers.find(lower_name);
+        }
+        return it != req.headers.end() ? it->second : std::string();
+    }
+
+    // The client may still be sending a body we refused. Closing a socket with
+    // unread data makes the kernel send RST, which can destroy the error
+    // response before the client reads it, so read and discard what follows
+    // for a while first. A plain socket also signals EOF right away, which
+    // stops clients that read the response while they upload.
+    void discard_unread_body(net::Transport& transport, size_t unread) {
+        static constexpr size_t kMaxDiscardBytes = 1 << 20;
+        static constexpr std::chrono::milliseconds kDiscardTimeout{1000};
+
+        if (!transport.is_secure()) {
+            ::shutdown(transport.fd(), SHUT_WR);
+        }
+
+        size_t budget = std::min(unread, kMaxDiscardBytes);
+        auto deadline = std::chrono::steady_clock::now() + kDiscardTimeout;
+        char buffer[8192];
+        while (budget > 0) {
+            if (!transport.has_buffered_input()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                pollfd pfd{transport.fd(), POLLIN, 0};
+                if (left.count() <= 0 || ::poll(&pfd, 1, static_cast<int>(left.count())) <= 0) {
+                    break;
+                }
+            }
+            ssize_t n = transport.read(buffer, std::min(sizeof(buffer), budget));
+            if (n <= 0) {
+                break;
+            }
+            budget -= static_cast<size_t>(n);
+        }
+    }
+
+    // Longest request line read before a connection is handed to its route's executor
+    constexpr size_t kMaxRequestLine = 8192;
+
+    // Feeds an HTTP/2 request body to a FormParser frame by frame
+    class FormBodySink : public http2::BodySink {
+    public:
+        FormBodySink(const std::string& content_type, const utils::FormLimits& limits) : form(content_type, limits) {}
+
+        bool write(const char* data, size_t len) override {
+            ok = ok && form.feed(data, len);
+            return ok;
+        }
+
+        bool finish(Request& req, Response& res) override {
+            if (ok && form.finish()) {
+                req.parts = form.take_parts();
+                return true;
+            }
+            res.status_code = form.error_status();
+            res.body = form.error();
+            res.content_type = "text/plain";
+            return false;
+        }
+
+    private:
+        utils::FormParser form;
+        bool ok = true;
+    };
+}
+
 Server::Server(size_t num_threads) {
     thread_pool = std::make_unique<threading::ThreadPool>(num_threads);
     router = std::make_unique<Router>();
+    metrics = std::make_unique<observability::MetricsRegistry>();
+    tracer = std::make_unique<observability::Tracer>();
+
+    threading::ThreadPool* pool = thread_pool.get();
+    metrics->set_pool_probes([pool] { return pool->get_queue_size(); },
+                             [pool] { return pool->get_thread_count(); });
+    open_wake_pipe(); // last, so a throwing constructor leaves no descriptors behind
 }
 
-Server::~Server() = default;
+Server::Server(const threading::PoolOptions& pool_options) {
+    router = std::make_unique<Router>();
+    metrics = std::make_unique<observability::MetricsRegistry>();
+    tracer = std::make_unique<observability::Tracer>();
+
+    // The pool is torn down first in ~Server, so it may keep a raw pointer to the registry
+    threading::PoolOptions options = pool_options;
+    observability::MetricsRegistry* registry = metrics.get();
+    options.on_resize = [registry, user_callback = pool_options.on_resize](size_t old_count, size_t new_count) {
+        registry->record_pool_resize(old_count, new_count);
+        if (user_callback) {
+            user_callback(old_count, new_count);
+        }
+    };
+    thread_pool = std::make_unique<threading::ThreadPool>(options);
+
+    threading::ThreadPool* pool = thread_pool.get();
+    metrics->set_pool_probes([pool] { return pool->get_queue_size(); },
+                             [pool] { return pool->get_thread_count(); });
+    open_wake_pipe(); // last, so a throwing constructor leaves no descriptors behind
+}
+
+Server::~Server() {
+    stop();
+    // Parked HTTP/2 connections are closed; nothing new gets parked after this
+    if (idle_watcher) {
+        idle_watcher->stop();
+    }
+    // Drain in-flight connections while the router and instrumentation they use still exist.
+    // The I/O pool stops first because its workers hand connections to the executors;
+    // it is freed last because HTTP/2 handlers on the executors hand streams back to it.
+    thread_pool->shutdown();
+    executors.clear();
+    thread_pool.reset();
+    ::close(wake_read_fd);
+    ::close(wake_write_fd);
+}
 
 void Server::get(const std::string& path, RouteHandler handler) {
     router->get(path, handler);
 }
 
 void Server::get(const std::string& path, const std::string& file_path) {
-    router->get(path, [file_path](const Request& req, Response& res) {
+    router->get(path, [file_path](const Request&, Response& res) {
         std::filesystem::path fp = file_path;
         if (std::filesystem::exists(fp) && std::filesystem::is_regular_file(fp)) {
             // Set file path for streaming instead of reading into memory
@@ -87,63 +245,399 @@ void Server::del(const std::string& path, RouteHandler handler) {
     router->del(path, handler);
 }
 
-void Server::listen(int port) {
-    ScopedFD server_fd(socket(AF_INET, SOCK_STREAM, 0));
-    if (!server_fd.is_valid()) {
-        throw std::runtime_error("Failed to create socket.");
+void Server::enable_metrics(const std::string& path) {
+    observability::MetricsRegistry* registry = metrics.get();
+    router->get(path, [registry](const Request&, Response& res) {
+        res.status_code = 200;
+        res.body = registry->render_prometheus();
+        res.content_type = "text/plain; version=0.0.4";
+    });
+}
+
+void Server::enable_tracing(double sample_rate, const std::string& path) {
+    tracer->set_sample_rate(sample_rate);
+    if (path.empty()) {
+        return;
+    }
+
+    observability::Tracer* trace_source = tracer.get();
+    router->get(path, [trace_source](const Request&, Response& res) {
+        res.status_code = 200;
+        res.body = trace_source->export_chrome_json();
+        res.content_type = "application/json";
+    });
+}
+
+void Server::enable_access_log(const observability::AccessLogConfig& config) {
+    access_log = std::make_unique<observability::AccessLog>(config);
+}
+
+void Server::add_executor(const std::string& name, const threading::ExecutorOptions& options) {
+    if (name.empty() || name == threading::Executor::kInline) {
+        throw std::invalid_argument("Executor name '" + name + "' is reserved");
     }
+    if (executors.count(name)) {
+        throw std::invalid_argument("Executor '" + name + "' already exists");
+    }
+    executors[name] = std::make_unique<threading::Executor>(name, options);
+}
+
+void Server::assign_executor(const std::string& method, const std::string& path, const std::string& executor) {
+    if (executor != threading::Executor::kInline && !executors.count(executor)) {
+        throw std::invalid_argument("Unknown executor '" + executor + "'");
+    }
+    router->set_executor(method, path, executor);
+}
 
-    int opt = 1;
-    if (setsockopt(server_fd.get(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        throw std::runtime_error("Failed to set socket options.");
+void Server::set_default_executor(const std::string& executor) {
+    if (executor != threading::Executor::kInline && !executors.count(executor)) {
+        throw std::invalid_argument("Unknown executor '" + executor + "'");
     }
+    default_executor = executor;
+}
+
+const threading::Executor* Server::get_executor(const std::string& name) const {
+    auto it = executors.find(name);
+    return it != executors.end() ? it->second.get() : nullptr;
+}
+
+void Server::enable_form_parsing(const utils::FormLimits& limits) {
+    form_parsing = true;
+    form_limits = limits;
+}
+
+void Server::enable_http2(bool enabled, const http2::ConnectionSettings& settings) {
+    http2_enabled = enabled;
+    http2_settings = settings;
+}
+
+#ifdef CPPWEB_WITH_TLS
+void Server::enable_tls(const net::TlsConfig& config) {
+    tls = std::make_unique<net::TlsContext>(config);
+}
+#endif
 
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
+int Server::add_listener(const net::Endpoint& endpoint) {
+    listeners.push_back(std::make_unique<net::Listener>(endpoint));
+    return listeners.back()->bound_port();
+}
+
+void Server::listen(int port) {
+    add_listener(net::Endpoint::tcp("0.0.0.0", port));
+    run();
+}
 
-    if (bind(server_fd.get(), (struct sockaddr*)&address, sizeof(address)) < 0) {
-        throw std::runtime_error("Failed to bind to port " + std::to_string(port) + ".");
+void Server::run() {
+    if (!closed_endpoints.empty()) {
+        // Endpoints added since the last run() follow the reopened ones
+        std::vector<std::unique_ptr<net::Listener>> reopened;
+        for (const auto& endpoint : closed_endpoints) {
+            reopened.push_back(std::make_unique<net::Listener>(endpoint));
+        }
+        for (auto& listener : listeners) {
+            reopened.push_back(std::move(listener));
+        }
+        listeners = std::move(reopened);
+        closed_endpoints.clear();
+    }
+    if (listeners.empty()) {
+        throw std::runtime_error("No endpoints to listen on.");
     }
 
-    if (::listen(server_fd.get(), 10) < 0) {
-        throw std::runtime_error("Failed to listen.");
+    if (http2_enabled && !idle_watcher) {
+        idle_watcher = std::make_unique<net::IdleWatcher>();
     }
 
-    std::cout << "Server listening on port " << port << "...\n";
+    std::vector<pollfd> poll_fds;
+    poll_fds.push_back({wake_read_fd, POLLIN, 0});
+    for (const auto& listener : listeners) {
+        poll_fds.push_back({listener->fd(), POLLIN, 0});
+        std::cout << "Server listening on " << listener->endpoint().describe() << "...\n";
+    }
 
-    while (true) {
-        int addrlen = sizeof(address);
-        int client_fd = accept(server_fd.get(), (struct sockaddr*)&address, (socklen_t*)&addrlen);
-        if (client_fd < 0) {
-            std::cerr << "Failed to accept connection.\n";
-            continue;
+    running.store(true);
+
+    while (running.load()) {
+        int ready = poll(poll_fds.data(), poll_fds.size(), -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Failed to poll listening sockets.\n";
+            break;
+        }
+        if (poll_fds[0].revents != 0) {
+            break; // stop() was called
         }
 
-        try {
-            thread_pool->enqueue([this, client_fd] {
-                this->handle_client(client_fd);
-            });
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to enqueue task: " << e.what() << "\n";
-            ::close(client_fd);
+        for (size_t i = 1; i < poll_fds.size(); ++i) {
+            if ((poll_fds[i].revents & POLLIN) == 0) {
+                continue;
+            }
+
+            // Drain the backlog so one wakeup serves a whole burst of connections
+            net::Listener& listener = *listeners[i - 1];
+            int client_fd = -1;
+            while (running.load() && (client_fd = listener.accept()) >= 0) {
+                enqueue_connection(client_fd, listener.endpoint().tls);
+            }
+            if (client_fd < 0 && errno != EAGAIN && errno != EWOULDBLOCK && running.load()) {
+                std::cerr << "Failed to accept connection.\n";
+            }
         }
     }
+
+    running.store(false);
+
+    // Endpoints keep the port they were given, so a restart binds the same ones
+    for (const auto& listener : listeners) {
+        closed_endpoints.push_back(listener->endpoint());
+    }
+    listeners.clear();
+
+    // Consume the wakeup so the next run() does not return at once
+    char drain[64];
+    while (read(wake_read_fd, drain, sizeof(drain)) > 0) {
+    }
 }
 
+void Server::stop() {
+    running.store(false);
+    // Wakes the thread blocked in poll(); a full pipe already holds a wakeup
+    char byte = 0;
+    ssize_t ignored = write(wake_write_fd, &byte, 1);
+    (void)ignored;
+}
 
-void Server::handle_client(int client_fd_raw) {
-    ScopedFD client_fd(client_fd_raw);
+void Server::open_wake_pipe() {
+    int wake_pipe[2];
+    if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        throw std::runtime_error("Failed to create wakeup pipe.");
+    }
+    wake_read_fd = wake_pipe[0];
+    wake_write_fd = wake_pipe[1];
+}
+
+void Server::enqueue_connection(int client_fd, bool use_tls) {
+    uint64_t accepted_ns = observability::now_ns();
+    uint64_t trace_id = tracer->sample();
+    metrics->connection_opened();
+
+    try {
+        thread_pool->enqueue([this, client_fd, accepted_ns, trace_id, use_tls] {
+            this->handle_client(client_fd, accepted_ns, trace_id, use_tls);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to enqueue task: " << e.what() << "\n";
+        ::close(client_fd);
+        metrics->connection_closed();
+        return;
+    }
+
+    if (trace_id != 0) {
+        tracer->record(trace_id, observability::TracePhase::Accept, accepted_ns, observability::now_ns());
+    }
+}
+
+
+// One HTTP/1.1 connection on its way from the I/O pool to the executor serving its route
+struct Server::ClientConnection {
+    // The queue wait and the close are normally recorded together with the
+    // connection's last request. Declared before the socket so that
+    // otherwise the connection is counted closed after ScopedFD released it.
+    struct ConnectionGuard {
+        observability::MetricsRegistry& registry;
+        uint64_t queue_wait_ns;
+        bool queue_wait_recorded = false;
+        bool close_recorded = false;
+        ~ConnectionGuard() {
+            if (!close_recorded) {
+                registry.connection_closed(queue_wait_recorded ? nullptr : &queue_wait_ns);
+            }
+        }
+    } connection_guard;
+
+    ScopedFD client_fd;
+
+    // Declared after client_fd so a TLS session is shut down before the socket closes
+    std::unique_ptr<net::Transport> transport;
 
     std::string raw_request;
+    uint64_t accepted_ns;
+    uint64_t trace_id;
+    uint64_t started_ns;
+
+    ClientConnection(observability::MetricsRegistry& registry, int fd, uint64_t accepted, uint64_t trace, uint64_t started)
+        : connection_guard{registry, started - accepted}, client_fd(fd), accepted_ns(accepted), trace_id(trace),
+          started_ns(started) {}
+};
+
+void Server::handle_client(int client_fd_raw, uint64_t accepted_ns, uint64_t trace_id, bool use_tls) {
+    uint64_t started_ns = observability::now_ns();
+    tracer->record(trace_id, observability::TracePhase::QueueWait, accepted_ns, started_ns);
+
+    // Shared so the connection can move to another executor's queue
+    auto conn = std::make_shared<ClientConnection>(*metrics, client_fd_raw, accepted_ns, trace_id, started_ns);
+
+#ifdef CPPWEB_WITH_TLS
+    if (tls && use_tls) {
+        conn->transport = tls->accept(conn->client_fd.get(), http2_enabled);
+        if (!conn->transport) {
+            return; // Handshake failed or timed out
+        }
+        if (conn->transport->negotiated_protocol() == "h2") {
+            serve_http2(conn, std::string(), nullptr, 0);
+            return;
+        }
+    }
+#endif
+    if (!conn->transport) {
+        conn->transport = std::make_unique<net::PlainTransport>(conn->client_fd.get());
+    }
+
+    std::string& raw_request = conn->raw_request;
     char buffer[8192];
-    ssize_t bytes_read = read(client_fd.get(), buffer, sizeof(buffer));
+    ssize_t bytes_read = conn->transport->read(buffer, sizeof(buffer));
     if (bytes_read <= 0) {
         return; // client_fd gets automatically closed by ScopedFD
     }
     raw_request.append(buffer, bytes_read);
 
+    // HTTP/2 with prior knowledge: the connection opens with the client preface
+    if (http2_enabled) {
+        while (raw_request.size() < http2::kClientPreface.size() && http2::starts_like_preface(raw_request)) {
+            bytes_read = conn->transport->read(buffer, sizeof(buffer));
+            if (bytes_read <= 0) return;
+            raw_request.append(buffer, bytes_read);
+        }
+        if (raw_request.compare(0, http2::kClientPreface.size(), http2::kClientPreface) == 0) {
+            serve_http2(conn, std::move(raw_request), nullptr, 0);
+            return;
+        }
+    }
+
+    // Bulkheads: a route with its own executor is served there from here on,
+    // body read included, so slow routes cannot tie up the I/O pool. The
+    // route is only known once the whole request line is in.
+    if (!executors.empty()) {
+        while (raw_request.find("\r\n") == std::string::npos && raw_request.size() < kMaxRequestLine) {
+            bytes_read = conn->transport->read(buffer, sizeof(buffer));
+            if (bytes_read <= 0) return;
+            raw_request.append(buffer, bytes_read);
+        }
+    }
+
+    std::string method, path;
+    threading::Executor* executor = executor_for_request(raw_request, method, path);
+    if (executor) {
+        // A Block executor gives up on a request that waited too long for a
+        // place. Its timer thread only hands the 503 to the I/O pool, so one
+        // slow client cannot hold up every other timeout.
+        auto on_timeout = [this, conn, method, path] {
+            try {
+                thread_pool->enqueue([this, conn, method, path] { reject_overloaded(*conn, method, path); });
+            } catch (const std::exception&) {
+                // Shutting down: the connection is closed once the last reference goes
+            }
+        };
+        switch (executor->submit([this, conn] { serve_http1(conn); }, on_timeout)) {
+            case threading::Executor::Admission::Queued:
+                return;
+            case threading::Executor::Admission::CallerRuns:
+                break;
+            case threading::Executor::Admission::Rejected:
+                reject_overloaded(*conn, method, path);
+                return;
+        }
+    }
+
+    serve_http1(conn);
+}
+
+threading::Executor* Server::executor_for_request(const std::string& raw_request, std::string& method, std::string& path) const {
+    if (executors.empty()) {
+        return nullptr;
+    }
+
+    size_t method_end = raw_request.find(' ');
+    size_t line_end = raw_request.find("\r\n");
+    if (method_end == std::string::npos || line_end == std::string::npos || method_end > line_end) {
+        return nullptr;
+    }
+    size_t target_end = raw_request.find(' ', method_end + 1);
+    if (target_end == std::string::npos || target_end > line_end) {
+        target_end = line_end;
+    }
+    method = raw_request.substr(0, method_end);
+    std::map<std::string, std::string> query_params;
+    utils::split_request_target(raw_request.substr(method_end + 1, target_end - method_end - 1), path, query_params);
+    return executor_for(method, path);
+}
+
+threading::Executor* Server::executor_for(const std::string& method, const std::string& path) const {
+    if (executors.empty()) {
+        return nullptr;
+    }
+    std::string name = router->executor_for(method, path);
+    if (name.empty()) {
+        name = default_executor;
+    }
+    auto it = executors.find(name);
+    return it != executors.end() ? it->second.get() : nullptr;
+}
+
+void Server::reject_overloaded(ClientConnection& conn, const std::string& method, const std::string& path) {
+    Request req;
+    req.method = method;
+    req.path = path;
+
+    Response res;
+    res.status_code = 503;
+    res.body = "503 Service Unavailable";
+    res.content_type = "text/plain";
+    res.headers["Retry-After"] = "1";
+
+    // Only the request line is known to be in. Without complete headers, or
+    // with a chunked body, whatever else arrives is discarded up to the limit
+    size_t unread = SIZE_MAX;
+    size_t header_end = conn.raw_request.find("\r\n\r\n");
+    if (header_end != std::string::npos &&
+        raw_header_value(conn.raw_request, header_end, "transfer-encoding").empty()) {
+        size_t body_received = conn.raw_request.size() - (header_end + 4);
+        std::string content_length = raw_header_value(conn.raw_request, header_end, "content-length");
+        try {
+            size_t length = content_length.empty() ? 0 : std::stoull(content_length);
+            unread = length > body_received ? length - body_received : 0;
+        } catch (const std::exception&) {
+            // Unparseable length: keep discarding up to the limit
+        }
+    }
+
+    size_t bytes_out = send_response(*conn.transport, res);
+    uint64_t finished_ns = observability::now_ns();
+    if (unread > 0) {
+        discard_unread_body(*conn.transport, unread);
+    }
+    record_exchange(req, res, true, "HTTP/1.1", access_log ? peer_address(conn.client_fd.get()) : std::string(),
+                    0, finished_ns - conn.accepted_ns, conn.raw_request.size(), bytes_out, &conn);
+}
+
+void Server::serve_http1(const std::shared_ptr<ClientConnection>& conn_ptr) {
+    ClientConnection& conn = *conn_ptr;
+    net::Transport* transport = conn.transport.get();
+    std::string& raw_request = conn.raw_request;
+    const uint64_t accepted_ns = conn.accepted_ns;
+    const uint64_t started_ns = conn.started_ns;
+    const uint64_t trace_id = conn.trace_id;
+    char buffer[8192];
+    ssize_t bytes_read;
+
+    // With form parsing on, a form body is fed to the parser as it arrives
+    // instead of being collected in raw_request
+    std::unique_ptr<utils::FormParser> form;
+    size_t streamed_body = 0;
+    size_t unread_body = 0;
+
     // Look for HTTP headers end to see if we have a body
     size_t header_end = raw_request.find("\r\n\r\n");
     if (header_end != std::string::npos) {
@@ -164,12 +658,35 @@ void Server::handle_client(int client_fd_raw) {
                     size_t content_length = std::stoull(cl_str);
                     size_t body_received = raw_request.length() - (header_end + 4);
 
-                    // Read the rest of the payload
-                    while (body_received < content_length) {
-                        bytes_read = read(client_fd.get(), buffer, sizeof(buffer));
-                        if (bytes_read <= 0) break;
-                        raw_request.append(buffer, bytes_read);
-                        body_received += bytes_read;
+                    if (form_parsing) {
+                        std::string content_type = raw_header_value(raw_request, header_end, "content-type");
+                        if (utils::FormParser::accepts(content_type)) {
+                            form = std::make_unique<utils::FormParser>(content_type, form_limits);
+                        }
+                    }
+
+                    if (form) {
+                        bool form_ok = form->feed(raw_request.data() + header_end + 4,
+                                                  std::min(body_received, content_length));
+                        raw_request.resize(header_end + 4);
+                        while (form_ok && body_received < content_length) {
+                            bytes_read = transport->read(buffer, sizeof(buffer));
+                            if (bytes_read <= 0) break;
+                            form_ok = form->feed(buffer, std::min<size_t>(bytes_read, content_length - body_received));
+                            body_received += bytes_read;
+                        }
+                        streamed_body = body_received;
+                        if (!form_ok && body_received < content_length) {
+                            unread_body = content_length - body_received;
+                        }
+                    } else {
+                        // Read the rest of the payload
+                        while (body_received < content_length) {
+                            bytes_read = transport->read(buffer, sizeof(buffer));
+                            if (bytes_read <= 0) break;
+                            raw_request.append(buffer, bytes_read);
+                            body_received += bytes_read;
+                        }
                     }
                 } catch (...) {
                     // Ignore content-length parsing errors
@@ -178,82 +695,337 @@ void Server::handle_client(int client_fd_raw) {
         }
     }
 
+    Request req;
+    Response res;
+    bool matched = false;
+    uint64_t read_done_ns = observability::now_ns();
+    uint64_t handler_start = read_done_ns;
+    uint64_t handler_ns = 0;
+
     try {
-        Request req = utils::parse_request(raw_request);
-        Response res;
+        req = utils::parse_request(raw_request);
+        bool form_ok = true;
+        if (form) {
+            form_ok = form->finish();
+            if (form_ok) {
+                req.parts = form->take_parts();
+            } else {
+                res.status_code = form->error_status();
+                res.body = form->error();
+                res.content_type = "text/plain";
+            }
+        }
 
-        router->route(req, res);
-        send_response(client_fd.get(), res);
+        // h2c is cleartext only; over TLS, HTTP/2 is negotiated through ALPN
+        if (http2_enabled && !transport->is_secure() && http2::is_h2c_upgrade(req)) {
+            static const std::string switching =
+                "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+            if (!transport->write_all(switching.data(), switching.size())) {
+                return;
+            }
+            serve_http2(conn_ptr, std::string(), &req, raw_request.size() + streamed_body);
+            return;
+        }
+
+        if (form_ok) {
+            handler_start = observability::now_ns();
+            matched = dispatch(req, res);
+            handler_ns = observability::now_ns() - handler_start;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Exception in request handling: " << e.what() << "\n";
-        Response res;
+        res = Response();
         res.status_code = 500;
         res.body = "500 Internal Server Error";
         res.content_type = "text/plain";
-        send_response(client_fd.get(), res);
     } catch (...) {
         std::cerr << "Unknown exception in request handling.\n";
-        Response res;
+        res = Response();
         res.status_code = 500;
         res.body = "500 Internal Server Error";
         res.content_type = "text/plain";
-        send_response(client_fd.get(), res);
+    }
+
+    uint64_t send_start = observability::now_ns();
+    size_t bytes_out = send_response(*transport, res);
+    uint64_t finished_ns = observability::now_ns();
+    if (unread_body > 0) {
+        discard_unread_body(*transport, unread_body);
+    }
+
+    record_exchange(req, res, matched, "HTTP/1.1", access_log ? peer_address(conn.client_fd.get()) : std::string(),
+                    handler_ns, finished_ns - accepted_ns, raw_request.size() + streamed_body, bytes_out, &conn);
+
+    if (trace_id != 0) {
+        using observability::TracePhase;
+        tracer->record(trace_id, TracePhase::Read, started_ns, read_done_ns);
+        tracer->record(trace_id, TracePhase::Parse, read_done_ns, handler_start);
+        tracer->record(trace_id, TracePhase::Handler, handler_start, handler_start + handler_ns);
+        tracer->record(trace_id, TracePhase::Send, send_start, finished_ns);
+        tracer->record(trace_id, TracePhase::Request, accepted_ns, finished_ns,
+                       req.method + " " + req.path, res.status_code);
     }
 }
 
+// An HTTP/2 connection between passes on the pool. pending counts wakeups:
+// whoever raises it from zero services the connection, and wakeups that
+// arrive meanwhile make that thread run another pass instead of a second
+// thread joining in.
+struct Server::Http2Session {
+    std::shared_ptr<ClientConnection> conn;
+    std::unique_ptr<http2::Connection> connection;
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> idle_expired{false};
+    bool finished = false;
+};
+
+void Server::serve_http2(const std::shared_ptr<ClientConnection>& conn, std::string initial_input, Request* upgraded,
+                         uint64_t upgraded_bytes) {
+    auto session = std::make_shared<Http2Session>();
+    session->conn = conn;
 
-void Server::send_response(int client_fd, const Response& res) {
-    std::ostringstream response_stream;
+    // The connection may stay open for long, so its queue wait is not held back until it closes
+    auto& guard = conn->connection_guard;
+    if (!guard.queue_wait_recorded) {
+        metrics->record_queue_wait(guard.queue_wait_ns);
+        guard.queue_wait_recorded = true;
+    }
 
-    size_t content_length = res.body.length();
-    if (!res.file_path.empty()) {
+    // Every stream on the connection shares one peer address
+    std::string remote = access_log ? peer_address(conn->client_fd.get()) : std::string();
+
+    http2::ConnectionCallbacks callbacks;
+    callbacks.dispatch = [this](Request& req, Response& res) {
+        return dispatch(req, res);
+    };
+    if (form_parsing) {
+        // Form bodies are parsed frame by frame as their DATA arrives
+        callbacks.body_sink = [this](const Request& req) -> std::shared_ptr<http2::BodySink> {
+            std::string content_type = header_value(req, "Content-Type", "content-type");
+            if (!utils::FormParser::accepts(content_type)) {
+                return nullptr;
+            }
+            return std::make_shared<FormBodySink>(content_type, form_limits);
+        };
+    }
+    callbacks.completed = [this, remote](const Request& req, const Response& res, const http2::StreamStats& stats) {
+        uint64_t handler_ns = stats.handler_end_ns - stats.handler_start_ns;
+        record_exchange(req, res, stats.matched, "HTTP/2.0", remote, handler_ns,
+                        stats.finished_ns - stats.started_ns, stats.bytes_in, stats.bytes_out, nullptr);
+
+        uint64_t trace_id = tracer->sample();
+        if (trace_id != 0) {
+            using observability::TracePhase;
+            tracer->record(trace_id, TracePhase::Handler, stats.handler_start_ns, stats.handler_end_ns);
+            tracer->record(trace_id, TracePhase::Request, stats.started_ns, stats.finished_ns,
+                           req.method + " " + req.path, res.status_code);
+        }
+    };
+    // Each stream's handler is its own task, on its route's executor or the
+    // pool; the connection's pass only frames and writes
+    callbacks.submit = [this](const Request& req, std::function<void()> task, std::function<void()> refuse) {
+        if (threading::Executor* executor = executor_for(req.method, req.path)) {
+            switch (executor->submit(task, std::move(refuse))) {
+                case threading::Executor::Admission::Queued:
+                    return true;
+                case threading::Executor::Admission::CallerRuns:
+                    task();
+                    return true;
+                case threading::Executor::Admission::Rejected:
+                    return false;
+            }
+        }
         try {
-            content_length = std::filesystem::file_size(res.file_path);
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to get file size for " << res.file_path << ": " << e.what() << "\n";
-            std::string error_response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
-            send(client_fd, error_response.c_str(), error_response.length(), MSG_NOSIGNAL);
+            thread_pool->enqueue(std::move(task));
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    };
+    std::weak_ptr<Http2Session> weak_session = session;
+    callbacks.wake = [this, weak_session] {
+        if (auto session = weak_session.lock()) {
+            wake_http2(session);
+        }
+    };
+
+    // A TLS record split across reads must not hold a worker until the rest
+    // arrives: on a non-blocking socket the read reports no input yet and the
+    // connection goes back to the idle watcher
+    if (conn->transport->is_secure()) {
+        int flags = fcntl(conn->client_fd.get(), F_GETFL, 0);
+        if (flags < 0 || fcntl(conn->client_fd.get(), F_SETFL, flags | O_NONBLOCK) < 0) {
+            return;
+        }
+    }
+
+    session->connection = std::make_unique<http2::Connection>(*conn->transport, std::move(callbacks), http2_settings);
+    if (upgraded) {
+        session->connection->adopt_upgrade(std::move(*upgraded), upgraded_bytes);
+    }
+    if (!session->connection->start(std::move(initial_input))) {
+        return;
+    }
+
+    session->pending.store(1);
+    drive_http2(session);
+}
+
+void Server::wake_http2(const std::shared_ptr<Http2Session>& session) {
+    if (session->pending.fetch_add(1) != 0) {
+        return; // Already queued or running; that pass will see this wakeup
+    }
+    try {
+        thread_pool->enqueue([this, session] { drive_http2(session); });
+    } catch (const std::exception&) {
+        // Shutting down: the connection is closed once the last reference goes
+    }
+}
+
+void Server::drive_http2(const std::shared_ptr<Http2Session>& session) {
+    size_t seen = session->pending.load();
+    while (true) {
+        if (!session->finished) {
+            http2::Connection& connection = *session->connection;
+            int fd = session->conn->client_fd.get();
+
+            bool open;
+            if (session->idle_expired.exchange(false) && !connection.handlers_running()) {
+                connection.close_idle();
+                open = false;
+            } else {
+                open = connection.service();
+            }
+
+            if (open) {
+                // No idle timeout while handlers run; their completion wakes the connection
+                auto timeout = connection.handlers_running() ? std::chrono::milliseconds(0) : http2_settings.idle_timeout;
+                open = idle_watcher->watch(fd, timeout, [this, session](bool readable) {
+                    if (!readable) {
+                        session->idle_expired.store(true);
+                    }
+                    wake_http2(session);
+                });
+            }
+
+            if (!open) {
+                session->finished = true;
+                idle_watcher->unwatch(fd);
+                session->connection.reset();
+                session->conn.reset();
+            }
+        }
+
+        size_t before = session->pending.fetch_sub(seen);
+        if (before == seen) {
             return;
         }
+        seen = before - seen;
     }
+}
 
-    response_stream << "HTTP/1.1 " << res.status_code << " " << utils::get_status_message(res.status_code) << "\r\n"
-                    << "Content-Type: " << res.content_type << "\r\n"
-                    << "Content-Length: " << content_length << "\r\n"
-                    << "Connection: close\r\n";
+bool Server::dispatch(const Request& req, Response& res) {
+    try {
+        return router->route(req, res);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in request handling: " << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "Unknown exception in request handling.\n";
+    }
+
+    res = Response();
+    res.status_code = 500;
+    res.body = "500 Internal Server Error";
+    res.content_type = "text/plain";
+    return false;
+}
+
+void Server::record_exchange(const Request& req, const Response& res, bool matched, const char* protocol,
+                             const std::string& remote, uint64_t handler_ns, uint64_t latency_ns,
+                             uint64_t bytes_in, uint64_t bytes_out, ClientConnection* closing) {
+    static const std::string unmatched_route = "<unmatched>";
+    const uint64_t* queue_wait_ns = nullptr;
+    bool connection_closed = false;
+    if (closing) {
+        auto& guard = closing->connection_guard;
+        if (!guard.queue_wait_recorded) {
+            queue_wait_ns = &guard.queue_wait_ns;
+            guard.queue_wait_recorded = true;
+        }
+        connection_closed = !guard.close_recorded;
+        guard.close_recorded = true;
+    }
+    metrics->record_request({
+        req.method,
+        matched ? req.path : unmatched_route,
+        res.status_code,
+        handler_ns,
+        latency_ns,
+        bytes_in,
+        bytes_out,
+        queue_wait_ns,
+        connection_closed
+    });
 
-    for (const auto& [key, value] : res.headers) {
-        response_stream << key << ": " << value << "\r\n";
+    if (access_log) {
+        observability::AccessRecord record;
+        record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record.latency_ns = latency_ns;
+        record.bytes_in = bytes_in;
+        record.bytes_out = bytes_out;
+        record.status_code = res.status_code;
+        record.set(record.method, req.method);
+        record.set(record.protocol, protocol);
+        record.set(record.remote, remote);
+        record.set(record.path, req.path);
+        record.set(record.referer, header_value(req, "Referer", "referer"));
+        record.set(record.user_agent, header_value(req, "User-Agent", "user-agent"));
+        access_log->log(record);
     }
+}
 
-    response_stream << "\r\n";
 
+size_t Server::send_response(net::Transport& transport, const Response& res) {
     if (res.file_path.empty()) {
-        // Send in-memory body
-        response_stream << res.body;
-        std::string response_str = response_stream.str();
-        send(client_fd, response_str.c_str(), response_str.length(), MSG_NOSIGNAL);
-    } else {
-        // Send headers first
-        std::string headers_str = response_stream.str();
-        send(client_fd, headers_str.c_str(), headers_str.length(), MSG_NOSIGNAL);
-
-        // Stream file content
-        std::ifstream file(res.file_path, std::ios::binary);
-        if (file) {
-            char buffer[8192];
-            while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-                ssize_t bytes_to_send = file.gcount();
-                const char* ptr = buffer;
-                while (bytes_to_send > 0) {
-                    ssize_t sent = send(client_fd, ptr, bytes_to_send, MSG_NOSIGNAL);
-                    if (sent <= 0) return; // Client disconnected or error
-                    ptr += sent;
-                    bytes_to_send -= sent;
-                }
+        // Gather the headers and the body (or its shared segments) into one
+        // write without copying the body
+        size_t body_size = res.body_size();
+        std::string head = utils::format_response_head(res, body_size);
+
+        std::vector<iovec> iov;
+        std::vector<net::FileSource> files;
+        iov.reserve(1 + std::max<size_t>(res.segments.size(), 1));
+        files.reserve(iov.capacity());
+        iov.push_back({head.data(), head.size()});
+        files.push_back({});
+        if (res.segments.empty()) {
+            iov.push_back({const_cast<char*>(res.body.data()), res.body.size()});
+            files.push_back({});
+        } else {
+            for (const auto& segment : res.segments) {
+                iov.push_back({const_cast<char*>(segment.data), segment.size});
+                files.push_back({segment.file_fd, segment.file_offset});
             }
         }
+        return transport.writev_all(iov.data(), files.data(), iov.size()) ? head.size() + body_size : 0;
+    }
+
+    ScopedFD file(::open(res.file_path.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat st;
+    if (!file.is_valid() || fstat(file.get(), &st) < 0 || !S_ISREG(st.st_mode)) {
+        std::cerr << "Failed to open " << res.file_path << " for sending.\n";
+        static const std::string error_response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        return transport.write_all(error_response.data(), error_response.length()) ? error_response.length() : 0;
+    }
+
+    // Send headers first, then let the transport stream the file (sendfile where it can)
+    uint64_t content_length = static_cast<uint64_t>(st.st_size);
+    std::string headers_str = utils::format_response_head(res, content_length);
+    if (!transport.write_all(headers_str.data(), headers_str.length())) {
+        return 0;
     }
+    return headers_str.length() + transport.send_file_all(file.get(), 0, content_length);
 }
 
 
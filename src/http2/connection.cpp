@@ -0,0 +1,1014 @@
+#include "../../include/cppweb/http2/connection.hpp"
+#include "../../include/cppweb/utils/http_utils.hpp"
+#include "../../include/cppweb/observability/metrics.hpp"
+#include <poll.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <vector>
+
+namespace cppweb::http2 {
+
+const std::string kClientPreface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+
+namespace {
+    enum FrameType : uint8_t {
+        FRAME_DATA = 0x0,
+        FRAME_HEADERS = 0x1,
+        FRAME_PRIORITY = 0x2,
+        FRAME_RST_STREAM = 0x3,
+        FRAME_SETTINGS = 0x4,
+        FRAME_PUSH_PROMISE = 0x5,
+        FRAME_PING = 0x6,
+        FRAME_GOAWAY = 0x7,
+        FRAME_WINDOW_UPDATE = 0x8,
+        FRAME_CONTINUATION = 0x9
+    };
+
+    constexpr uint8_t FLAG_END_STREAM = 0x1;
+    constexpr uint8_t FLAG_ACK = 0x1;
+    constexpr uint8_t FLAG_END_HEADERS = 0x4;
+    constexpr uint8_t FLAG_PADDED = 0x8;
+    constexpr uint8_t FLAG_PRIORITY = 0x20;
+
+    enum ErrorCode : uint32_t {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb
+    };
+
+    enum SettingId : uint16_t {
+        SETTINGS_HEADER_TABLE_SIZE = 0x1,
+        SETTINGS_ENABLE_PUSH = 0x2,
+        SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+        SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+        SETTINGS_MAX_FRAME_SIZE = 0x5,
+        SETTINGS_MAX_HEADER_LIST_SIZE = 0x6
+    };
+
+    constexpr int64_t kMaxWindow = 0x7fffffff;
+    constexpr size_t kFrameHeaderSize = 9;
+
+    uint32_t read_u32(const uint8_t* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    void append_u32(std::string& out, uint32_t value) {
+        out += static_cast<char>(value >> 24);
+        out += static_cast<char>(value >> 16);
+        out += static_cast<char>(value >> 8);
+        out += static_cast<char>(value);
+    }
+
+    void append_frame_header(std::string& out, size_t length, uint8_t type, uint8_t flags, uint32_t stream_id) {
+        out += static_cast<char>(length >> 16);
+        out += static_cast<char>(length >> 8);
+        out += static_cast<char>(length);
+        out += static_cast<char>(type);
+        out += static_cast<char>(flags);
+        append_u32(out, stream_id & 0x7fffffff);
+    }
+
+    void append_setting(std::string& out, uint16_t id, uint32_t value) {
+        out += static_cast<char>(id >> 8);
+        out += static_cast<char>(id);
+        append_u32(out, value);
+    }
+
+    char ascii_lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    std::string to_lower(const std::string& value) {
+        std::string out = value;
+        std::transform(out.begin(), out.end(), out.begin(), ascii_lower);
+        return out;
+    }
+
+    // "content-type" -> "Content-Type", so handlers written against
+    // HTTP/1.1 header spellings keep working.
+    std::string canonical_header_name(const std::string& name) {
+        std::string out = name;
+        bool upper = true;
+        for (char& c : out) {
+            if (upper && c >= 'a' && c <= 'z') {
+                c = static_cast<char>(c - 'a' + 'A');
+            }
+            upper = c == '-';
+        }
+        return out;
+    }
+
+    bool is_connection_specific(const std::string& lower_name) {
+        return lower_name == "connection" || lower_name == "keep-alive" || lower_name == "proxy-connection" ||
+               lower_name == "transfer-encoding" || lower_name == "upgrade";
+    }
+
+    const std::string* find_header_ci(const std::map<std::string, std::string>& headers, const std::string& lower_name) {
+        for (const auto& [key, value] : headers) {
+            if (to_lower(key) == lower_name) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+    bool has_token(const std::string& value, const std::string& lower_token) {
+        size_t start = 0;
+        while (start <= value.size()) {
+            size_t end = value.find(',', start);
+            if (end == std::string::npos) end = value.size();
+            size_t first = value.find_first_not_of(" \t", start);
+            size_t last = value.find_last_not_of(" \t", end == 0 ? 0 : end - 1);
+            if (first != std::string::npos && first < end && last != std::string::npos && last >= first &&
+                to_lower(value.substr(first, last - first + 1)) == lower_token) {
+                return true;
+            }
+            start = end + 1;
+        }
+        return false;
+    }
+
+    bool base64url_decode(const std::string& in, std::string& out) {
+        auto value_of = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '-' || c == '+') return 62;
+            if (c == '_' || c == '/') return 63;
+            return -1;
+        };
+
+        uint32_t acc = 0;
+        int bits = 0;
+        for (char c : in) {
+            if (c == '=') break;
+            int v = value_of(c);
+            if (v < 0) return false;
+            acc = (acc << 6) | static_cast<uint32_t>(v);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += static_cast<char>((acc >> bits) & 0xff);
+            }
+        }
+        return true;
+    }
+
+    void run_handler(const std::function<bool(Request&, Response&)>& dispatch, BodySink* body_sink,
+                     Request& req, Response& res, StreamStats& stats) {
+        stats.handler_start_ns = observability::now_ns();
+        try {
+            if (!body_sink || body_sink->finish(req, res)) {
+                stats.matched = dispatch(req, res);
+            }
+        } catch (...) {
+            res = Response();
+            res.status_code = 500;
+            res.body = "500 Internal Server Error";
+            res.content_type = "text/plain";
+        }
+        stats.handler_end_ns = observability::now_ns();
+    }
+
+    void set_unavailable(Response& res) {
+        res = Response();
+        res.status_code = 503;
+        res.body = "503 Service Unavailable";
+        res.content_type = "text/plain";
+        res.headers["Retry-After"] = "1";
+    }
+}
+
+bool starts_like_preface(const std::string& data) {
+    size_t n = std::min(data.size(), kClientPreface.size());
+    return n > 0 && data.compare(0, n, kClientPreface, 0, n) == 0;
+}
+
+bool is_h2c_upgrade(const Request& req) {
+    const std::string* upgrade = find_header_ci(req.headers, "upgrade");
+    return upgrade && has_token(*upgrade, "h2c") && find_header_ci(req.headers, "http2-settings") != nullptr;
+}
+
+struct Connection::Stream {
+    explicit Stream(uint32_t id) { stats.stream_id = id; }
+    ~Stream() {
+        if (file_fd >= 0) ::close(file_fd);
+    }
+
+    Request request;
+    Response response;
+    StreamStats stats;
+
+    std::shared_ptr<BodySink> body_sink;
+    bool body_refused = false;
+
+    bool end_stream_received = false;
+    bool dispatched = false;
+    bool response_started = false;
+
+    int64_t send_window = 0;
+    int64_t recv_window = 0;
+    uint64_t recv_credit = 0;
+
+    // Response body source: in-memory segments or a file read in chunks
+    std::vector<BodySegment> segments;
+    size_t segment_index = 0;
+    size_t segment_offset = 0;
+    int file_fd = -1;
+    uint64_t file_offset = 0;
+    uint64_t remaining = 0;
+};
+
+// Handlers on other threads report back through here, never touching the
+// Connection itself, which may be gone by the time they finish
+struct Connection::Handoff {
+    std::function<bool(Request&, Response&)> dispatch;
+    std::function<void()> wake;
+
+    std::mutex mutex;
+    std::vector<uint32_t> finished;
+
+    // Hands a stream back to the connection, from whichever thread held it
+    void report(uint32_t stream_id) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.push_back(stream_id);
+        }
+        if (wake) {
+            wake();
+        }
+    }
+};
+
+Connection::Connection(net::Transport& transport, ConnectionCallbacks callbacks, ConnectionSettings settings)
+    : transport(transport), callbacks(std::move(callbacks)), settings(settings),
+      decoder(4096, settings.max_header_list_size),
+      handoff(std::make_shared<Handoff>()),
+      conn_recv_window(settings.connection_window_size) {
+    handoff->dispatch = this->callbacks.dispatch;
+    handoff->wake = this->callbacks.wake;
+}
+
+Connection::~Connection() = default;
+
+void Connection::adopt_upgrade(Request req, uint64_t bytes_in) {
+    // HTTP2-Settings carries the client's SETTINGS payload, base64url-encoded
+    if (const std::string* encoded = find_header_ci(req.headers, "http2-settings")) {
+        std::string payload;
+        if (base64url_decode(*encoded, payload)) {
+            for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data() + i);
+                apply_setting(static_cast<uint16_t>((p[0] << 8) | p[1]), read_u32(p + 2));
+            }
+        }
+    }
+
+    auto stream = std::make_shared<Stream>(1);
+    stream->request = std::move(req);
+    stream->end_stream_received = true;
+    stream->send_window = peer_initial_window;
+    stream->recv_window = settings.initial_window_size;
+    stream->stats.started_ns = observability::now_ns();
+    stream->stats.bytes_in = bytes_in;
+    streams[1] = std::move(stream);
+    last_client_stream = 1;
+}
+
+bool Connection::start(std::string initial_input) {
+    input = std::move(initial_input);
+
+    queue_settings();
+    if (settings.connection_window_size > 65535) {
+        queue_window_update(0, settings.connection_window_size - 65535);
+    }
+    return flush();
+}
+
+bool Connection::service() {
+    if (dead) {
+        return false;
+    }
+
+    // Take what has arrived, but only a few reads' worth per pass so one
+    // busy connection cannot keep the thread from the others
+    for (int reads = 0; reads < 4; ++reads) {
+        if (!transport.has_buffered_input()) {
+            pollfd pfd{transport.fd(), POLLIN, 0};
+            if (::poll(&pfd, 1, 0) <= 0) break;
+        }
+        if (!read_available()) return false;
+    }
+
+    if (!preface_received) {
+        if (input.size() < kClientPreface.size()) {
+            if (starts_like_preface(input) || input.empty()) return true;
+        } else if (input.compare(0, kClientPreface.size(), kClientPreface) == 0) {
+            input.erase(0, kClientPreface.size());
+            preface_received = true;
+        }
+        if (!preface_received) {
+            connection_error(PROTOCOL_ERROR);
+            flush();
+            return false;
+        }
+    }
+
+    collect_finished_handlers();
+    if (!process_input()) {
+        flush();
+        return false;
+    }
+    dispatch_ready_streams();
+    collect_finished_handlers(); // handlers the submitter ran in place
+
+    while (!dead && pump_data()) {}
+    if (dead || !flush()) {
+        return false;
+    }
+    return !(closing && streams.empty());
+}
+
+void Connection::close_idle() {
+    connection_error(NO_ERROR);
+    flush();
+}
+
+bool Connection::read_available() {
+    char chunk[16384];
+    ssize_t n = transport.read(chunk, sizeof(chunk));
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true; // Part of a TLS record; the rest wakes the connection again
+    }
+    if (n <= 0) {
+        dead = true;
+        return false;
+    }
+    input.append(chunk, static_cast<size_t>(n));
+    return true;
+}
+
+bool Connection::process_input() {
+    size_t offset = 0;
+    bool ok = true;
+
+    while (input.size() - offset >= kFrameHeaderSize) {
+        const uint8_t* header = reinterpret_cast<const uint8_t*>(input.data() + offset);
+        uint32_t length = (uint32_t(header[0]) << 16) | (uint32_t(header[1]) << 8) | header[2];
+        uint8_t type = header[3];
+        uint8_t flags = header[4];
+        uint32_t stream_id = read_u32(header + 5) & 0x7fffffff;
+
+        if (length > settings.max_frame_size) {
+            ok = connection_error(FRAME_SIZE_ERROR);
+            break;
+        }
+        if (input.size() - offset < kFrameHeaderSize + length) {
+            break;
+        }
+
+        ok = handle_frame(type, flags, stream_id, header + kFrameHeaderSize, length);
+        offset += kFrameHeaderSize + length;
+        if (!ok) break;
+    }
+    input.erase(0, offset);
+
+    if (ok && conn_recv_credit >= settings.connection_window_size / 2) {
+        queue_window_update(0, static_cast<uint32_t>(conn_recv_credit));
+        conn_recv_window += static_cast<int64_t>(conn_recv_credit);
+        conn_recv_credit = 0;
+    }
+    return ok;
+}
+
+bool Connection::handle_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    if (continuation_stream != 0 && (type != FRAME_CONTINUATION || stream_id != continuation_stream)) {
+        return connection_error(PROTOCOL_ERROR);
+    }
+
+    switch (type) {
+        case FRAME_DATA:
+            return on_data(flags, stream_id, payload, length);
+
+        case FRAME_HEADERS:
+            return on_headers(flags, stream_id, payload, length);
+
+        case FRAME_PRIORITY:
+            // Prioritization is advisory; validate and ignore
+            if (stream_id == 0) return connection_error(PROTOCOL_ERROR);
+            if (length != 5) reset_stream(stream_id, FRAME_SIZE_ERROR);
+            return true;
+
+        case FRAME_RST_STREAM:
+            if (stream_id == 0 || stream_id > last_client_stream) return connection_error(PROTOCOL_ERROR);
+            if (length != 4) return connection_error(FRAME_SIZE_ERROR);
+            streams.erase(stream_id);
+            return true;
+
+        case FRAME_SETTINGS:
+            return on_settings(flags, stream_id, payload, length);
+
+        case FRAME_PUSH_PROMISE:
+            return connection_error(PROTOCOL_ERROR);
+
+        case FRAME_PING:
+            if (stream_id != 0) return connection_error(PROTOCOL_ERROR);
+            if (length != 8) return connection_error(FRAME_SIZE_ERROR);
+            if (!(flags & FLAG_ACK)) {
+                queue_frame(FRAME_PING, FLAG_ACK, 0, payload, 8);
+            }
+            return true;
+
+        case FRAME_GOAWAY:
+            if (stream_id != 0) return connection_error(PROTOCOL_ERROR);
+            closing = true; // finish what is in flight, accept nothing new
+            return true;
+
+        case FRAME_WINDOW_UPDATE:
+            return on_window_update(stream_id, payload, length);
+
+        case FRAME_CONTINUATION:
+            if (continuation_stream == 0) return connection_error(PROTOCOL_ERROR);
+            return on_continuation(flags, stream_id, payload, length);
+
+        default:
+            return true; // Unknown frame types must be ignored
+    }
+}
+
+bool Connection::on_data(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    if (stream_id == 0) {
+        return connection_error(PROTOCOL_ERROR);
+    }
+
+    const uint8_t* data = payload;
+    size_t data_length = length;
+    if (flags & FLAG_PADDED) {
+        if (length < 1 || payload[0] >= length) return connection_error(PROTOCOL_ERROR);
+        data = payload + 1;
+        data_length = length - 1 - payload[0];
+    }
+
+    // The whole frame, padding included, counts against flow control
+    conn_recv_window -= length;
+    if (conn_recv_window < 0) {
+        return connection_error(FLOW_CONTROL_ERROR);
+    }
+    conn_recv_credit += length;
+
+    auto it = streams.find(stream_id);
+    if (it == streams.end() || it->second->end_stream_received) {
+        if (stream_id > last_client_stream) return connection_error(PROTOCOL_ERROR);
+        reset_stream(stream_id, STREAM_CLOSED);
+        return true;
+    }
+
+    Stream& stream = *it->second;
+    stream.recv_window -= length;
+    if (stream.recv_window < 0) {
+        reset_stream(stream_id, FLOW_CONTROL_ERROR);
+        return true;
+    }
+
+    if (!stream.body_sink) {
+        stream.request.body.append(reinterpret_cast<const char*>(data), data_length);
+    } else if (!stream.body_refused && data_length > 0) {
+        stream.body_refused = !stream.body_sink->write(reinterpret_cast<const char*>(data), data_length);
+    }
+    stream.stats.bytes_in += length;
+
+    if (flags & FLAG_END_STREAM) {
+        stream.end_stream_received = true;
+    } else {
+        stream.recv_credit += length;
+        if (stream.recv_credit >= settings.initial_window_size / 2) {
+            queue_window_update(stream_id, static_cast<uint32_t>(stream.recv_credit));
+            stream.recv_window += static_cast<int64_t>(stream.recv_credit);
+            stream.recv_credit = 0;
+        }
+    }
+    return true;
+}
+
+bool Connection::on_headers(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    if (stream_id == 0) {
+        return connection_error(PROTOCOL_ERROR);
+    }
+
+    size_t begin = 0;
+    size_t end = length;
+    if (flags & FLAG_PADDED) {
+        if (length < 1) return connection_error(PROTOCOL_ERROR);
+        size_t padding = payload[0];
+        begin = 1;
+        if (padding > length - begin) return connection_error(PROTOCOL_ERROR);
+        end -= padding;
+    }
+    if (flags & FLAG_PRIORITY) {
+        begin += 5;
+    }
+    if (begin > end) {
+        return connection_error(FRAME_SIZE_ERROR);
+    }
+
+    header_block.assign(reinterpret_cast<const char*>(payload + begin), end - begin);
+    if (flags & FLAG_END_HEADERS) {
+        return finish_header_block(stream_id, flags);
+    }
+
+    continuation_stream = stream_id;
+    continuation_flags = flags;
+    return true;
+}
+
+bool Connection::on_continuation(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    header_block.append(reinterpret_cast<const char*>(payload), length);
+    if (header_block.size() > settings.max_header_list_size) {
+        return connection_error(ENHANCE_YOUR_CALM);
+    }
+    if (!(flags & FLAG_END_HEADERS)) {
+        return true;
+    }
+
+    continuation_stream = 0;
+    return finish_header_block(stream_id, continuation_flags);
+}
+
+bool Connection::finish_header_block(uint32_t stream_id, uint8_t flags) {
+    HeaderList fields;
+    try {
+        // Always decode, even for streams we refuse, to keep HPACK state in sync
+        fields = decoder.decode(reinterpret_cast<const uint8_t*>(header_block.data()), header_block.size());
+    } catch (const HpackListTooLarge&) {
+        // Decoding stopped part way, so the table can no longer be trusted
+        return connection_error(ENHANCE_YOUR_CALM);
+    } catch (const HpackError&) {
+        return connection_error(COMPRESSION_ERROR);
+    }
+    size_t block_size = header_block.size();
+    header_block.clear();
+    bool end_stream = (flags & FLAG_END_STREAM) != 0;
+
+    auto existing = streams.find(stream_id);
+    if (existing != streams.end()) {
+        // Trailers: must close the stream; their fields are not surfaced
+        Stream& stream = *existing->second;
+        if (stream.end_stream_received) return connection_error(STREAM_CLOSED);
+        if (!end_stream) {
+            reset_stream(stream_id, PROTOCOL_ERROR);
+            return true;
+        }
+        stream.end_stream_received = true;
+        stream.stats.bytes_in += block_size;
+        return true;
+    }
+
+    if (stream_id % 2 == 0 || stream_id <= last_client_stream) {
+        return connection_error(PROTOCOL_ERROR);
+    }
+    last_client_stream = stream_id;
+
+    if (closing) {
+        return true;
+    }
+    if (streams.size() >= settings.max_concurrent_streams) {
+        reset_stream(stream_id, REFUSED_STREAM);
+        return true;
+    }
+
+    auto stream = std::make_shared<Stream>(stream_id);
+    Request& req = stream->request;
+    std::string target;
+    std::string authority;
+    bool regular_seen = false;
+    bool valid = true;
+
+    for (auto& [name, value] : fields) {
+        if (!name.empty() && name[0] == ':') {
+            if (regular_seen) valid = false;
+            if (name == ":method") req.method = value;
+            else if (name == ":path") target = value;
+            else if (name == ":authority") authority = value;
+            else if (name != ":scheme") valid = false;
+            continue;
+        }
+
+        regular_seen = true;
+        if (name != to_lower(name) || is_connection_specific(name) || (name == "te" && value != "trailers")) {
+            valid = false;
+            continue;
+        }
+
+        std::string key = canonical_header_name(name);
+        auto it = req.headers.find(key);
+        if (it == req.headers.end()) {
+            req.headers.emplace(std::move(key), std::move(value));
+        } else {
+            // Cookies may be split into several fields (RFC 7540, section 8.1.2.5)
+            it->second += (name == "cookie" ? "; " : ", ") + value;
+        }
+    }
+
+    if (!valid || req.method.empty() || target.empty()) {
+        reset_stream(stream_id, PROTOCOL_ERROR);
+        return true;
+    }
+
+    utils::split_request_target(target, req.path, req.query_params);
+    if (!authority.empty() && req.headers.find("Host") == req.headers.end()) {
+        req.headers["Host"] = authority;
+    }
+
+    if (callbacks.body_sink && !end_stream) {
+        stream->body_sink = callbacks.body_sink(req);
+    }
+    stream->end_stream_received = end_stream;
+    stream->send_window = peer_initial_window;
+    stream->recv_window = settings.initial_window_size;
+    stream->stats.started_ns = observability::now_ns();
+    stream->stats.bytes_in = block_size;
+    streams[stream_id] = std::move(stream);
+    return true;
+}
+
+bool Connection::on_settings(uint8_t flags, uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    if (stream_id != 0) {
+        return connection_error(PROTOCOL_ERROR);
+    }
+    if (flags & FLAG_ACK) {
+        return length == 0 ? true : connection_error(FRAME_SIZE_ERROR);
+    }
+    if (length % 6 != 0) {
+        return connection_error(FRAME_SIZE_ERROR);
+    }
+
+    for (uint32_t i = 0; i < length; i += 6) {
+        uint16_t id = static_cast<uint16_t>((payload[i] << 8) | payload[i + 1]);
+        if (!apply_setting(id, read_u32(payload + i + 2))) {
+            return false;
+        }
+    }
+
+    queue_frame(FRAME_SETTINGS, FLAG_ACK, 0, nullptr, 0);
+    return true;
+}
+
+bool Connection::apply_setting(uint16_t id, uint32_t value) {
+    switch (id) {
+        case SETTINGS_HEADER_TABLE_SIZE:
+            encoder.set_max_table_size(value);
+            return true;
+
+        case SETTINGS_ENABLE_PUSH:
+            return value <= 1 ? true : connection_error(PROTOCOL_ERROR);
+
+        case SETTINGS_INITIAL_WINDOW_SIZE: {
+            if (value > kMaxWindow) return connection_error(FLOW_CONTROL_ERROR);
+            int64_t delta = static_cast<int64_t>(value) - peer_initial_window;
+            for (auto& [sid, stream] : streams) {
+                stream->send_window += delta;
+                if (stream->send_window > kMaxWindow) return connection_error(FLOW_CONTROL_ERROR);
+            }
+            peer_initial_window = value;
+            return true;
+        }
+
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < 16384 || value > 16777215) return connection_error(PROTOCOL_ERROR);
+            peer_max_frame_size = value;
+            return true;
+
+        default:
+            return true; // MAX_CONCURRENT_STREAMS and MAX_HEADER_LIST_SIZE do not limit a server
+    }
+}
+
+bool Connection::on_window_update(uint32_t stream_id, const uint8_t* payload, uint32_t length) {
+    if (length != 4) {
+        return connection_error(FRAME_SIZE_ERROR);
+    }
+    int64_t increment = read_u32(payload) & 0x7fffffff;
+
+    if (stream_id == 0) {
+        if (increment == 0) return connection_error(PROTOCOL_ERROR);
+        conn_send_window += increment;
+        return conn_send_window > kMaxWindow ? connection_error(FLOW_CONTROL_ERROR) : true;
+    }
+
+    auto it = streams.find(stream_id);
+    if (it == streams.end()) {
+        return stream_id > last_client_stream ? connection_error(PROTOCOL_ERROR) : true;
+    }
+    if (increment == 0) {
+        reset_stream(stream_id, PROTOCOL_ERROR);
+        return true;
+    }
+    it->second->send_window += increment;
+    if (it->second->send_window > kMaxWindow) {
+        reset_stream(stream_id, FLOW_CONTROL_ERROR);
+    }
+    return true;
+}
+
+void Connection::dispatch_ready_streams() {
+    std::vector<std::shared_ptr<Stream>> ready;
+    for (const auto& [id, stream] : streams) {
+        if (stream->end_stream_received && !stream->dispatched) {
+            ready.push_back(stream);
+        }
+    }
+
+    for (auto& stream : ready) {
+        stream->dispatched = true;
+
+        if (!callbacks.submit) {
+            run_handler(callbacks.dispatch, stream->body_sink.get(), stream->request, stream->response, stream->stats);
+            start_response(*stream);
+            continue;
+        }
+
+        // Until the task or its refusal reports back, only that thread
+        // touches the stream's request and response
+        Request& req = stream->request;
+        auto task = [stream, handoff = handoff] {
+            run_handler(handoff->dispatch, stream->body_sink.get(), stream->request, stream->response, stream->stats);
+            handoff->report(stream->stats.stream_id);
+        };
+        auto refuse = [stream, handoff = handoff] {
+            set_unavailable(stream->response);
+            handoff->report(stream->stats.stream_id);
+        };
+
+        ++running_handlers;
+        if (!callbacks.submit(req, std::move(task), std::move(refuse))) {
+            --running_handlers;
+            set_unavailable(stream->response);
+            start_response(*stream);
+        }
+    }
+}
+
+void Connection::collect_finished_handlers() {
+    std::vector<uint32_t> finished;
+    {
+        std::unique_lock<std::mutex> lock(handoff->mutex);
+        finished.swap(handoff->finished);
+    }
+
+    for (uint32_t id : finished) {
+        --running_handlers;
+        // The stream is gone if it was reset while its handler ran
+        auto it = streams.find(id);
+        if (it != streams.end() && !it->second->response_started) {
+            start_response(*it->second);
+        }
+    }
+}
+
+void Connection::start_response(Stream& stream) {
+    Response& res = stream.response;
+
+    if (!res.file_path.empty()) {
+        stream.file_fd = ::open(res.file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (stream.file_fd >= 0 && fstat(stream.file_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            stream.remaining = static_cast<uint64_t>(st.st_size);
+        } else {
+            if (stream.file_fd >= 0) ::close(stream.file_fd);
+            stream.file_fd = -1;
+            res.status_code = 500;
+            res.body = "500 Internal Server Error";
+            res.content_type = "text/plain";
+            res.file_path.clear();
+        }
+    }
+    if (stream.file_fd < 0) {
+        // An owned body becomes a shared segment so DATA frames can reference
+        // it even after the stream is gone but before output is flushed
+        if (!res.segments.empty()) {
+            stream.segments = std::move(res.segments);
+            res.segments.clear();
+        } else if (!res.body.empty()) {
+            auto owned = std::make_shared<const std::string>(std::move(res.body));
+            stream.segments.push_back({owned, owned->data(), owned->size(), -1, 0});
+        }
+        res.body.clear();
+        for (const auto& segment : stream.segments) {
+            stream.remaining += segment.size;
+        }
+    }
+
+    HeaderList fields;
+    fields.emplace_back(":status", std::to_string(res.status_code));
+    if (!res.content_type.empty()) {
+        fields.emplace_back("content-type", res.content_type);
+    }
+    fields.emplace_back("content-length", std::to_string(stream.remaining));
+    for (const auto& [key, value] : res.headers) {
+        std::string name = to_lower(key);
+        if (is_connection_specific(name) || name == "content-length") continue;
+        fields.emplace_back(std::move(name), value);
+    }
+
+    std::string block;
+    encoder.encode(fields, block);
+
+    bool body_follows = stream.remaining > 0;
+    size_t offset = 0;
+    bool first = true;
+    do {
+        size_t chunk = std::min<size_t>(block.size() - offset, peer_max_frame_size);
+        bool last = offset + chunk == block.size();
+        uint8_t flags = last ? FLAG_END_HEADERS : 0;
+        if (first && !body_follows) flags |= FLAG_END_STREAM;
+        queue_frame(first ? FRAME_HEADERS : FRAME_CONTINUATION, flags, stream.stats.stream_id,
+                    block.data() + offset, chunk);
+        stream.stats.bytes_out += kFrameHeaderSize + chunk;
+        offset += chunk;
+        first = false;
+    } while (offset < block.size());
+
+    stream.response_started = true;
+    if (!body_follows) {
+        finish_stream(stream.stats.stream_id);
+    }
+}
+
+bool Connection::pump_data() {
+    bool progress = false;
+    std::vector<uint32_t> finished;
+
+    // One frame per stream per pass, so concurrent responses interleave
+    for (auto& [id, stream_ptr] : streams) {
+        Stream& stream = *stream_ptr;
+        if (!stream.response_started || stream.remaining == 0) continue;
+        if (conn_send_window <= 0) break;
+
+        int64_t allowed = std::min<int64_t>({
+            static_cast<int64_t>(stream.remaining),
+            static_cast<int64_t>(peer_max_frame_size),
+            conn_send_window,
+            stream.send_window
+        });
+        if (allowed <= 0) continue;
+
+        size_t chunk = static_cast<size_t>(allowed);
+        bool last = chunk == stream.remaining;
+        append_frame_header(output, chunk, FRAME_DATA, last ? FLAG_END_STREAM : 0, id);
+
+        if (stream.file_fd >= 0) {
+            // File payloads bypass the output buffer so the transport can use
+            // sendfile (or kernel TLS) for them
+            if (!flush() || transport.send_file_all(stream.file_fd, static_cast<off_t>(stream.file_offset), chunk) != chunk) {
+                // Write failure, or the file shrank underneath us; the frame cannot be completed
+                dead = true;
+                return false;
+            }
+            stream.file_offset += chunk;
+        } else {
+            queue_body(stream, chunk);
+        }
+
+        stream.remaining -= chunk;
+        stream.send_window -= allowed;
+        conn_send_window -= allowed;
+        stream.stats.bytes_out += kFrameHeaderSize + chunk;
+        progress = true;
+
+        if (last) {
+            finished.push_back(id);
+        }
+        if (output.size() + gathered_bytes >= settings.write_batch_bytes && !flush()) {
+            return false;
+        }
+    }
+
+    for (uint32_t id : finished) {
+        finish_stream(id);
+    }
+    return progress;
+}
+
+void Connection::queue_body(Stream& stream, size_t length) {
+    // Copying small pieces is cheaper than an extra iovec entry
+    static constexpr size_t kGatherMinBytes = 1024;
+
+    while (length > 0) {
+        const BodySegment& segment = stream.segments[stream.segment_index];
+        size_t take = std::min(length, segment.size - stream.segment_offset);
+        const char* data = segment.data + stream.segment_offset;
+
+        // A mapped file is never read here, where a truncated page would raise SIGBUS
+        if (take < kGatherMinBytes && segment.file_fd < 0) {
+            output.append(data, take);
+        } else {
+            gathered.push_back({output.size(), {segment.owner, data, take, segment.file_fd,
+                                                segment.file_offset + stream.segment_offset}});
+            gathered_bytes += take;
+        }
+
+        length -= take;
+        stream.segment_offset += take;
+        if (stream.segment_offset == segment.size) {
+            ++stream.segment_index;
+            stream.segment_offset = 0;
+        }
+    }
+}
+
+void Connection::finish_stream(uint32_t stream_id) {
+    auto it = streams.find(stream_id);
+    if (it == streams.end()) return;
+
+    Stream& stream = *it->second;
+    stream.stats.finished_ns = observability::now_ns();
+    if (callbacks.completed) {
+        callbacks.completed(stream.request, stream.response, stream.stats);
+    }
+    streams.erase(it);
+}
+
+void Connection::queue_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const void* payload, size_t length) {
+    append_frame_header(output, length, type, flags, stream_id);
+    if (length > 0) {
+        output.append(static_cast<const char*>(payload), length);
+    }
+}
+
+void Connection::queue_settings() {
+    std::string payload;
+    append_setting(payload, SETTINGS_MAX_CONCURRENT_STREAMS, settings.max_concurrent_streams);
+    append_setting(payload, SETTINGS_INITIAL_WINDOW_SIZE, settings.initial_window_size);
+    append_setting(payload, SETTINGS_MAX_HEADER_LIST_SIZE, settings.max_header_list_size);
+    if (settings.max_frame_size != 16384) {
+        append_setting(payload, SETTINGS_MAX_FRAME_SIZE, settings.max_frame_size);
+    }
+    queue_frame(FRAME_SETTINGS, 0, 0, payload.data(), payload.size());
+}
+
+void Connection::queue_window_update(uint32_t stream_id, uint32_t increment) {
+    std::string payload;
+    append_u32(payload, increment & 0x7fffffff);
+    queue_frame(FRAME_WINDOW_UPDATE, 0, stream_id, payload.data(), payload.size());
+}
+
+void Connection::reset_stream(uint32_t stream_id, uint32_t error_code) {
+    std::string payload;
+    append_u32(payload, error_code);
+    queue_frame(FRAME_RST_STREAM, 0, stream_id, payload.data(), payload.size());
+    streams.erase(stream_id);
+}
+
+bool Connection::connection_error(uint32_t error_code) {
+    std::string payload;
+    append_u32(payload, last_client_stream);
+    append_u32(payload, error_code);
+    queue_frame(FRAME_GOAWAY, 0, 0, payload.data(), payload.size());
+    closing = true;
+    return false;
+}
+
+bool Connection::flush() {
+    bool ok;
+    if (gathered.empty()) {
+        ok = output.empty() || transport.write_all(output.data(), output.size());
+    } else {
+        std::vector<iovec> iov;
+        std::vector<net::FileSource> files;
+        iov.reserve(gathered.size() * 2 + 1);
+        files.reserve(iov.capacity());
+        size_t pos = 0;
+        for (const auto& slice : gathered) {
+            if (slice.output_pos > pos) {
+                iov.push_back({&output[pos], slice.output_pos - pos});
+                files.push_back({});
+                pos = slice.output_pos;
+            }
+            iov.push_back({const_cast<char*>(slice.segment.data), slice.segment.size});
+            files.push_back({slice.segment.file_fd, slice.segment.file_offset});
+        }
+        if (pos < output.size()) {
+            iov.push_back({&output[pos], output.size() - pos});
+            files.push_back({});
+        }
+        ok = transport.writev_all(iov.data(), files.data(), iov.size());
+        gathered.clear();
+        gathered_bytes = 0;
+    }
+    output.clear();
+    if (!ok) {
+        dead = true;
+    }
+    return ok;
+}
+
+} // namespace cppweb::http2
@@ -0,0 +1,523 @@
+#include "../../include/cppweb/http2/hpack.hpp"
+#include <algorithm>
+#include <array>
+
+namespace cppweb::http2 {
+
+namespace {
+    // RFC 7541, Appendix A
+    const HeaderField kStaticTable[] = {
+        {":authority", ""},
+        {":method", "GET"},
+        {":method", "POST"},
+        {":path", "/"},
+        {":path", "/index.html"},
+        {":scheme", "http"},
+        {":scheme", "https"},
+        {":status", "200"},
+        {":status", "204"},
+        {":status", "206"},
+        {":status", "304"},
+        {":status", "400"},
+        {":status", "404"},
+        {":status", "500"},
+        {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""},
+        {"accept-ranges", ""},
+        {"accept", ""},
+        {"access-control-allow-origin", ""},
+        {"age", ""},
+        {"allow", ""},
+        {"authorization", ""},
+        {"cache-control", ""},
+        {"content-disposition", ""},
+        {"content-encoding", ""},
+        {"content-language", ""},
+        {"content-length", ""},
+        {"content-location", ""},
+        {"content-range", ""},
+        {"content-type", ""},
+        {"cookie", ""},
+        {"date", ""},
+        {"etag", ""},
+        {"expect", ""},
+        {"expires", ""},
+        {"from", ""},
+        {"host", ""},
+        {"if-match", ""},
+        {"if-modified-since", ""},
+        {"if-none-match", ""},
+        {"if-range", ""},
+        {"if-unmodified-since", ""},
+        {"last-modified", ""},
+        {"link", ""},
+        {"location", ""},
+        {"max-forwards", ""},
+        {"proxy-authenticate", ""},
+        {"proxy-authorization", ""},
+        {"range", ""},
+        {"referer", ""},
+        {"refresh", ""},
+        {"retry-after", ""},
+        {"server", ""},
+        {"set-cookie", ""},
+        {"strict-transport-security", ""},
+        {"transfer-encoding", ""},
+        {"user-agent", ""},
+        {"vary", ""},
+        {"via", ""},
+        {"www-authenticate", ""},
+    };
+    constexpr size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+    // Per-entry overhead counted against the table size (RFC 7541, section 4.1)
+    constexpr size_t kEntryOverhead = 32;
+
+    // Caps decoded integers well above any legitimate length or index
+    constexpr uint64_t kMaxInteger = uint64_t(1) << 32;
+
+    struct HuffmanCode {
+        uint32_t code;
+        uint8_t length;
+    };
+
+    // RFC 7541, Appendix B; index 256 is EOS
+    const HuffmanCode kHuffmanCodes[257] = {
+        {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+        {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+        {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+        {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+        {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+        {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+        {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+        {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+        {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+        {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+        {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+        {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+        {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+        {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+        {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+        {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+        {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+        {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+        {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+        {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+        {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+        {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+        {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+        {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+        {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+        {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+        {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+        {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+        {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+        {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+        {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+        {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+        {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+        {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+        {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+        {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+        {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+        {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+        {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+        {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+        {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+        {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+        {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+        {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+        {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+        {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+        {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+        {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+        {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+        {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+        {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+        {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+        {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+        {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+        {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+        {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+        {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+        {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+        {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+        {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+        {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+        {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+        {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+        {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+        {0x3fffffff, 30}
+    };
+
+    constexpr uint16_t kEos = 256;
+
+    // Binary trie over kHuffmanCodes, built once; leaves carry the symbol
+    struct HuffmanTrie {
+        struct Node {
+            int16_t children[2] = {-1, -1};
+            int16_t symbol = -1;
+        };
+        std::vector<Node> nodes;
+
+        HuffmanTrie() {
+            nodes.reserve(2 * 257);
+            nodes.emplace_back();
+            for (uint16_t sym = 0; sym <= kEos; ++sym) {
+                const HuffmanCode& hc = kHuffmanCodes[sym];
+                size_t node = 0;
+                for (int bit = hc.length - 1; bit >= 0; --bit) {
+                    int b = (hc.code >> bit) & 1;
+                    if (nodes[node].children[b] < 0) {
+                        nodes[node].children[b] = static_cast<int16_t>(nodes.size());
+                        nodes.emplace_back();
+                    }
+                    node = static_cast<size_t>(nodes[node].children[b]);
+                }
+                nodes[node].symbol = static_cast<int16_t>(sym);
+            }
+        }
+    };
+
+    const HuffmanTrie& huffman_trie() {
+        static const HuffmanTrie trie;
+        return trie;
+    }
+
+    uint64_t decode_integer(const uint8_t* data, size_t length, size_t& pos, unsigned prefix_bits) {
+        if (pos >= length) {
+            throw HpackError("Truncated integer");
+        }
+        uint64_t max_prefix = (uint64_t(1) << prefix_bits) - 1;
+        uint64_t value = data[pos++] & max_prefix;
+        if (value < max_prefix) {
+            return value;
+        }
+
+        unsigned shift = 0;
+        while (true) {
+            if (pos >= length) {
+                throw HpackError("Truncated integer");
+            }
+            uint8_t byte = data[pos++];
+            value += static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (value > kMaxInteger) {
+                throw HpackError("Integer overflow");
+            }
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+            shift += 7;
+        }
+    }
+
+    std::string decode_string(const uint8_t* data, size_t length, size_t& pos) {
+        if (pos >= length) {
+            throw HpackError("Truncated string");
+        }
+        bool huffman = (data[pos] & 0x80) != 0;
+        uint64_t str_len = decode_integer(data, length, pos, 7);
+        if (str_len > length - pos) {
+            throw HpackError("String exceeds header block");
+        }
+
+        const uint8_t* start = data + pos;
+        pos += static_cast<size_t>(str_len);
+        if (huffman) {
+            return hpack::huffman_decode(start, static_cast<size_t>(str_len));
+        }
+        return std::string(reinterpret_cast<const char*>(start), static_cast<size_t>(str_len));
+    }
+
+    bool is_sensitive(const std::string& name) {
+        return name == "set-cookie" || name == "authorization" || name == "proxy-authorization";
+    }
+}
+
+// --- HpackTable ------------------------------------------------------------
+
+void HpackTable::add(const std::string& name, const std::string& value) {
+    size_t entry_size = name.size() + value.size() + kEntryOverhead;
+    if (entry_size > max_size) {
+        // An entry larger than the table empties it (RFC 7541, section 4.4)
+        entries.clear();
+        current_size = 0;
+        return;
+    }
+    evict_to(max_size - entry_size);
+    entries.emplace_front(name, value);
+    current_size += entry_size;
+}
+
+void HpackTable::set_max_size(size_t size) {
+    max_size = size;
+    evict_to(max_size);
+}
+
+void HpackTable::evict_to(size_t limit) {
+    while (current_size > limit && !entries.empty()) {
+        const HeaderField& oldest = entries.back();
+        current_size -= oldest.first.size() + oldest.second.size() + kEntryOverhead;
+        entries.pop_back();
+    }
+}
+
+const HeaderField* HpackTable::get(size_t index) const {
+    if (index == 0) {
+        return nullptr;
+    }
+    if (index <= kStaticTableSize) {
+        return &kStaticTable[index - 1];
+    }
+    size_t dynamic_index = index - kStaticTableSize - 1;
+    return dynamic_index < entries.size() ? &entries[dynamic_index] : nullptr;
+}
+
+size_t HpackTable::find(const std::string& name, const std::string& value, bool& name_only) const {
+    size_t name_match = 0;
+    for (size_t i = 0; i < kStaticTableSize; ++i) {
+        if (kStaticTable[i].first == name) {
+            if (kStaticTable[i].second == value) {
+                name_only = false;
+                return i + 1;
+            }
+            if (name_match == 0) {
+                name_match = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].first == name) {
+            if (entries[i].second == value) {
+                name_only = false;
+                return kStaticTableSize + i + 1;
+            }
+            if (name_match == 0) {
+                name_match = kStaticTableSize + i + 1;
+            }
+        }
+    }
+    name_only = name_match != 0;
+    return name_match;
+}
+
+// --- HpackDecoder ----------------------------------------------------------
+
+HeaderList HpackDecoder::decode(const uint8_t* data, size_t length) {
+    HeaderList headers;
+    size_t pos = 0;
+    size_t list_size = 0;
+
+    auto account = [&](const std::string& name, const std::string& value) {
+        list_size += name.size() + value.size() + 32;
+        if (list_size > max_list_size) {
+            throw HpackListTooLarge("Decoded header list exceeds " + std::to_string(max_list_size) + " bytes");
+        }
+    };
+
+    while (pos < length) {
+        uint8_t byte = data[pos];
+
+        if (byte & 0x80) {
+            // Indexed header field
+            uint64_t index = decode_integer(data, length, pos, 7);
+            const HeaderField* field = table.get(static_cast<size_t>(index));
+            if (!field) {
+                throw HpackError("Invalid header index " + std::to_string(index));
+            }
+            account(field->first, field->second);
+            headers.push_back(*field);
+        } else if ((byte & 0xe0) == 0x20) {
+            // Dynamic table size update, only allowed before the first field
+            if (!headers.empty()) {
+                throw HpackError("Table size update after header field");
+            }
+            uint64_t size = decode_integer(data, length, pos, 5);
+            if (size > settings_limit) {
+                throw HpackError("Table size update exceeds SETTINGS_HEADER_TABLE_SIZE");
+            }
+            table.set_max_size(static_cast<size_t>(size));
+        } else {
+            // Literal: with incremental indexing (01), without (0000) or never indexed (0001)
+            bool incremental = (byte & 0xc0) == 0x40;
+            uint64_t index = decode_integer(data, length, pos, incremental ? 6 : 4);
+
+            std::string name;
+            if (index != 0) {
+                const HeaderField* field = table.get(static_cast<size_t>(index));
+                if (!field) {
+                    throw HpackError("Invalid header name index " + std::to_string(index));
+                }
+                name = field->first;
+            } else {
+                name = decode_string(data, length, pos);
+            }
+            std::string value = decode_string(data, length, pos);
+            account(name, value);
+
+            if (incremental) {
+                table.add(name, value);
+            }
+            headers.emplace_back(std::move(name), std::move(value));
+        }
+    }
+
+    return headers;
+}
+
+// --- HpackEncoder ----------------------------------------------------------
+
+void HpackEncoder::set_max_table_size(size_t size) {
+    // Never use more than the default, whatever the peer allows
+    size = std::min<size_t>(size, 4096);
+    min_size_since_update = std::min(min_size_since_update, size);
+    pending_size_update = true;
+    table.set_max_size(size);
+}
+
+void HpackEncoder::encode(const HeaderList& headers, std::string& out) {
+    if (pending_size_update) {
+        if (min_size_since_update < table.get_max_size()) {
+            hpack::encode_integer(min_size_since_update, 5, 0x20, out);
+        }
+        hpack::encode_integer(table.get_max_size(), 5, 0x20, out);
+        pending_size_update = false;
+        min_size_since_update = SIZE_MAX;
+    }
+
+    for (const auto& [name, value] : headers) {
+        bool name_only = false;
+        size_t index = table.find(name, value, name_only);
+
+        if (index != 0 && !name_only) {
+            hpack::encode_integer(index, 7, 0x80, out);
+            continue;
+        }
+
+        bool sensitive = is_sensitive(name);
+        bool worth_indexing = !sensitive && name != "content-length" &&
+            name.size() + value.size() + kEntryOverhead <= table.get_max_size() / 4;
+
+        if (worth_indexing) {
+            hpack::encode_integer(index, 6, 0x40, out);
+        } else {
+            hpack::encode_integer(index, 4, sensitive ? 0x10 : 0x00, out);
+        }
+        if (index == 0) {
+            hpack::encode_string(name, out);
+        }
+        hpack::encode_string(value, out);
+
+        if (worth_indexing) {
+            table.add(name, value);
+        }
+    }
+}
+
+// --- Primitives ------------------------------------------------------------
+
+namespace hpack {
+
+void encode_integer(uint64_t value, unsigned prefix_bits, uint8_t first_byte_flags, std::string& out) {
+    uint64_t max_prefix = (uint64_t(1) << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out += static_cast<char>(first_byte_flags | value);
+        return;
+    }
+
+    out += static_cast<char>(first_byte_flags | max_prefix);
+    value -= max_prefix;
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void encode_string(const std::string& value, std::string& out) {
+    size_t huffman_length = huffman_encoded_length(value);
+    if (huffman_length < value.size()) {
+        encode_integer(huffman_length, 7, 0x80, out);
+        out += huffman_encode(value);
+    } else {
+        encode_integer(value.size(), 7, 0x00, out);
+        out += value;
+    }
+}
+
+size_t huffman_encoded_length(const std::string& value) {
+    uint64_t bits = 0;
+    for (unsigned char c : value) {
+        bits += kHuffmanCodes[c].length;
+    }
+    return static_cast<size_t>((bits + 7) / 8);
+}
+
+std::string huffman_encode(const std::string& value) {
+    std::string out;
+    out.reserve(huffman_encoded_length(value));
+
+    uint64_t acc = 0;
+    unsigned bits = 0;
+    for (unsigned char c : value) {
+        const HuffmanCode& hc = kHuffmanCodes[c];
+        acc = (acc << hc.length) | hc.code;
+        bits += hc.length;
+        while (bits >= 8) {
+            bits -= 8;
+            out += static_cast<char>(acc >> bits);
+        }
+        acc &= (uint64_t(1) << bits) - 1;
+    }
+
+    if (bits > 0) {
+        // Pad with the most significant bits of EOS, which are all ones
+        out += static_cast<char>((acc << (8 - bits)) | (0xffu >> bits));
+    }
+    return out;
+}
+
+std::string huffman_decode(const uint8_t* data, size_t length) {
+    const auto& nodes = huffman_trie().nodes;
+    std::string out;
+    out.reserve(length * 8 / 5);
+
+    size_t node = 0;
+    unsigned pending_bits = 0;
+    bool pending_all_ones = true;
+
+    for (size_t i = 0; i < length; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            int b = (data[i] >> bit) & 1;
+            int16_t next = nodes[node].children[b];
+            if (next < 0) {
+                throw HpackError("Invalid Huffman code");
+            }
+            node = static_cast<size_t>(next);
+            ++pending_bits;
+            pending_all_ones = pending_all_ones && b == 1;
+
+            int16_t symbol = nodes[node].symbol;
+            if (symbol >= 0) {
+                if (symbol == kEos) {
+                    throw HpackError("EOS in Huffman-coded string");
+                }
+                out += static_cast<char>(symbol);
+                node = 0;
+                pending_bits = 0;
+                pending_all_ones = true;
+            }
+        }
+    }
+
+    // Leftover bits must be a strict prefix of EOS, shorter than a byte
+    if (pending_bits > 7 || !pending_all_ones) {
+        throw HpackError("Invalid Huffman padding");
+    }
+    return out;
+}
+
+} // namespace hpack
+
+} // namespace cppweb::http2
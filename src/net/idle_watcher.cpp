@@ -0,0 +1,194 @@
+#include "../../include/cppweb/net/idle_watcher.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cppweb::net {
+
+IdleWatcher::IdleWatcher() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        throw std::runtime_error("Failed to create epoll instance.");
+    }
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        ::close(epoll_fd);
+        throw std::runtime_error("Failed to create wakeup eventfd.");
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0) {
+        ::close(wake_fd);
+        ::close(epoll_fd);
+        throw std::runtime_error("Failed to watch wakeup eventfd.");
+    }
+
+    thread = std::thread([this] { loop(); });
+}
+
+IdleWatcher::~IdleWatcher() {
+    stop();
+    ::close(wake_fd);
+    ::close(epoll_fd);
+}
+
+bool IdleWatcher::watch(int fd, std::chrono::milliseconds timeout, Callback callback) {
+    Callback replaced;
+    bool earliest = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopped) {
+            return false;
+        }
+
+        // Registered under the lock, so an event that fires at once still finds its entry
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 &&
+            (errno != EEXIST || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0)) {
+            return false;
+        }
+
+        Entry& entry = entries[fd];
+        replaced = std::move(entry.callback);
+        entry.callback = std::move(callback);
+        if (entry.has_deadline) {
+            deadlines.erase(entry.deadline);
+            entry.has_deadline = false;
+        }
+        if (timeout.count() > 0) {
+            entry.deadline = deadlines.emplace(Clock::now() + timeout, fd);
+            entry.has_deadline = true;
+            earliest = entry.deadline == deadlines.begin();
+        }
+    }
+
+    // A new earliest deadline shortens the thread's current wait
+    if (earliest) {
+        wake();
+    }
+    return true;
+}
+
+void IdleWatcher::unwatch(int fd) {
+    Callback dropped;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        dropped = take(fd);
+        if (dropped) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+}
+
+void IdleWatcher::stop() {
+    std::unordered_map<int, Entry> dropped;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopped) {
+            return;
+        }
+        stopped = true;
+        dropped.swap(entries);
+        deadlines.clear();
+    }
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    // Callbacks may own connections; they are released here, outside the lock
+}
+
+size_t IdleWatcher::size() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void IdleWatcher::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+IdleWatcher::Callback IdleWatcher::take(int fd) {
+    auto it = entries.find(fd);
+    if (it == entries.end()) {
+        return nullptr;
+    }
+    Callback callback = std::move(it->second.callback);
+    if (it->second.has_deadline) {
+        deadlines.erase(it->second.deadline);
+    }
+    entries.erase(it);
+    return callback;
+}
+
+void IdleWatcher::loop() {
+    epoll_event events[64];
+    std::vector<std::pair<Callback, bool>> due;
+
+    while (true) {
+        int timeout_ms = -1;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopped) {
+                return;
+            }
+            if (!deadlines.empty()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadlines.begin()->first - Clock::now());
+                // Round up so the thread does not spin just before a deadline
+                timeout_ms = left.count() < 0 ? 0 : static_cast<int>(left.count()) + 1;
+            }
+        }
+
+        int ready = epoll_wait(epoll_fd, events, 64, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "[IdleWatcher] epoll_wait failed.\n";
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopped) {
+                return;
+            }
+
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd) {
+                    uint64_t count;
+                    ssize_t ignored = ::read(wake_fd, &count, sizeof(count));
+                    (void)ignored;
+                    continue;
+                }
+                // One-shot: the socket stays registered but disarmed until the next watch()
+                if (Callback callback = take(fd)) {
+                    due.emplace_back(std::move(callback), true);
+                }
+            }
+
+            auto now = Clock::now();
+            while (!deadlines.empty() && deadlines.begin()->first <= now) {
+                int fd = deadlines.begin()->second;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                due.emplace_back(take(fd), false);
+            }
+        }
+
+        for (auto& [callback, readable] : due) {
+            callback(readable);
+        }
+        due.clear();
+    }
+}
+
+} // namespace cppweb::net
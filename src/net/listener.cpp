@@ -0,0 +1,189 @@
+#include "../../include/cppweb/net/listener.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace cppweb::net {
+
+namespace {
+    void set_option(int fd, int level, int name, int value, const Endpoint& endpoint, const char* what) {
+        if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+            throw std::runtime_error(std::string("Failed to set ") + what + " on " + endpoint.describe() +
+                                     ": " + std::strerror(errno));
+        }
+    }
+
+    // Whether some process still accepts connections on a Unix socket path
+    bool unix_socket_in_use(const sockaddr_storage& addr, socklen_t addr_len) {
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (probe < 0) {
+            return false;
+        }
+        int result = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), addr_len);
+        // EAGAIN: the listener is alive but its backlog is full
+        bool in_use = result == 0 || errno == EAGAIN;
+        ::close(probe);
+        return in_use;
+    }
+}
+
+Endpoint Endpoint::tcp(const std::string& address, int port) {
+    Endpoint endpoint;
+    endpoint.address = address;
+    endpoint.port = port;
+    return endpoint;
+}
+
+Endpoint Endpoint::unix_socket(const std::string& path, mode_t permissions) {
+    Endpoint endpoint;
+    endpoint.kind = Kind::Unix;
+    endpoint.path = path;
+    endpoint.permissions = permissions;
+    endpoint.tls = false;
+    return endpoint;
+}
+
+std::string Endpoint::describe() const {
+    if (kind == Kind::Unix) {
+        return "unix:" + path;
+    }
+    if (address.find(':') != std::string::npos) {
+        return "[" + address + "]:" + std::to_string(port);
+    }
+    return address + ":" + std::to_string(port);
+}
+
+Listener::Listener(const Endpoint& endpoint) : endpoint_(endpoint) {
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    int family;
+
+    if (endpoint.kind == Endpoint::Kind::Unix) {
+        auto* un = reinterpret_cast<sockaddr_un*>(&addr);
+        if (endpoint.path.empty() || endpoint.path.size() >= sizeof(un->sun_path)) {
+            throw std::runtime_error("Invalid Unix socket path: " + endpoint.path);
+        }
+        family = AF_UNIX;
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, endpoint.path.c_str(), endpoint.path.size() + 1);
+        addr_len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + endpoint.path.size() + 1);
+
+        // Replace a socket left behind by an earlier run, but never any other
+        // file and never a socket another process is still serving
+        struct stat st;
+        if (lstat(endpoint.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            if (unix_socket_in_use(addr, addr_len)) {
+                throw std::runtime_error("Unix socket " + endpoint.path + " is in use by another process");
+            }
+            ::unlink(endpoint.path.c_str());
+        }
+    } else if (endpoint.address.find(':') != std::string::npos) {
+        auto* in6 = reinterpret_cast<sockaddr_in6*>(&addr);
+        family = AF_INET6;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(static_cast<uint16_t>(endpoint.port));
+        if (inet_pton(AF_INET6, endpoint.address.c_str(), &in6->sin6_addr) != 1) {
+            throw std::runtime_error("Invalid IPv6 address: " + endpoint.address);
+        }
+        addr_len = sizeof(sockaddr_in6);
+    } else {
+        auto* in4 = reinterpret_cast<sockaddr_in*>(&addr);
+        family = AF_INET;
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(static_cast<uint16_t>(endpoint.port));
+        if (inet_pton(AF_INET, endpoint.address.c_str(), &in4->sin_addr) != 1) {
+            throw std::runtime_error("Invalid IPv4 address: " + endpoint.address);
+        }
+        addr_len = sizeof(sockaddr_in);
+    }
+
+    fd_ = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to create socket.");
+    }
+
+    try {
+        if (family != AF_UNIX) {
+            set_option(fd_, SOL_SOCKET, SO_REUSEADDR, 1, endpoint, "SO_REUSEADDR");
+            if (endpoint.reuse_port) {
+                set_option(fd_, SOL_SOCKET, SO_REUSEPORT, 1, endpoint, "SO_REUSEPORT");
+            }
+            if (family == AF_INET6) {
+                set_option(fd_, IPPROTO_IPV6, IPV6_V6ONLY, endpoint.v6_only ? 1 : 0, endpoint, "IPV6_V6ONLY");
+            }
+            if (endpoint.defer_accept_seconds > 0) {
+                set_option(fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, endpoint.defer_accept_seconds, endpoint, "TCP_DEFER_ACCEPT");
+            }
+        }
+
+        // The socket file is created with the umask's permissions. Owner-only
+        // until chmod, so nobody else can connect before the requested mode is set.
+        int bound;
+        if (family == AF_UNIX) {
+            mode_t old_mask = ::umask(0177);
+            bound = ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), addr_len);
+            int bind_errno = errno;
+            ::umask(old_mask);
+            errno = bind_errno;
+        } else {
+            bound = ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), addr_len);
+        }
+        if (bound < 0) {
+            throw std::runtime_error("Failed to bind to " + endpoint.describe() + ": " + std::strerror(errno));
+        }
+
+        if (family == AF_UNIX) {
+            if (::chmod(endpoint.path.c_str(), endpoint.permissions) < 0) {
+                ::unlink(endpoint.path.c_str());
+                throw std::runtime_error("Failed to set permissions on " + endpoint.path + ": " + std::strerror(errno));
+            }
+        } else if (endpoint.fastopen_queue > 0) {
+            // TCP_FASTOPEN is applied after bind; unsupported kernels only lose the optimization
+            int queue = endpoint.fastopen_queue;
+            setsockopt(fd_, IPPROTO_TCP, TCP_FASTOPEN, &queue, sizeof(queue));
+        }
+
+        if (::listen(fd_, endpoint.backlog) < 0) {
+            throw std::runtime_error("Failed to listen on " + endpoint.describe() + ": " + std::strerror(errno));
+        }
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+
+    if (family != AF_UNIX) {
+        sockaddr_storage bound{};
+        socklen_t bound_len = sizeof(bound);
+        if (getsockname(fd_, reinterpret_cast<sockaddr*>(&bound), &bound_len) == 0) {
+            bound_port_ = family == AF_INET6
+                ? ntohs(reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port)
+                : ntohs(reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+        }
+        endpoint_.port = bound_port_;
+    }
+}
+
+Listener::~Listener() {
+    ::close(fd_);
+    if (endpoint_.kind == Endpoint::Kind::Unix) {
+        ::unlink(endpoint_.path.c_str());
+    }
+}
+
+int Listener::accept() {
+    int client;
+    do {
+        client = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (client < 0 && errno == EINTR);
+    return client;
+}
+
+} // namespace cppweb::net
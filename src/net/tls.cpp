@@ -0,0 +1,329 @@
+#include "../../include/cppweb/net/tls.hpp"
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+
+// SSL_sendfile() and SSL_OP_ENABLE_KTLS arrived in OpenSSL 3.0
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+#define CPPWEB_HAVE_KTLS 1
+#endif
+
+namespace cppweb::net {
+
+namespace {
+    // Largest TLS record payload, also the size Transport::writev() gathers into
+    constexpr size_t kMaxRecordSize = 16384;
+
+    std::string openssl_error() {
+        unsigned long code = ERR_get_error();
+        if (code == 0) {
+            return "unknown error";
+        }
+        char text[256];
+        ERR_error_string_n(code, text, sizeof(text));
+        ERR_clear_error();
+        return text;
+    }
+
+    // Waits until a non-blocking socket can make the progress OpenSSL asked
+    // for; false for any other error
+    bool wait_for_retry(int fd, int error) {
+        short events;
+        if (error == SSL_ERROR_WANT_READ) {
+            events = POLLIN;
+        } else if (error == SSL_ERROR_WANT_WRITE) {
+            events = POLLOUT;
+        } else {
+            return error == SSL_ERROR_SYSCALL && errno == EINTR;
+        }
+        pollfd pfd{fd, events, 0};
+        int ready;
+        do {
+            ready = ::poll(&pfd, 1, -1);
+        } while (ready < 0 && errno == EINTR);
+        return ready > 0;
+    }
+
+    std::string to_alpn_wire(const std::vector<std::string>& protocols, bool allow_h2) {
+        std::string wire;
+        for (const auto& proto : protocols) {
+            if (proto.empty() || proto.size() > 255 || (!allow_h2 && proto == "h2")) {
+                continue;
+            }
+            wire += static_cast<char>(proto.size());
+            wire += proto;
+        }
+        return wire;
+    }
+
+    // Runs SSL_accept on a non-blocking socket, polling for whatever time is
+    // left, so the timeout bounds the whole handshake and not each read
+    int accept_with_deadline(SSL* ssl, int fd, std::chrono::milliseconds timeout) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            return -1;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        int result;
+        while (true) {
+            ERR_clear_error();
+            result = SSL_accept(ssl);
+            if (result == 1) {
+                break;
+            }
+
+            int error = SSL_get_error(ssl, result);
+            short events;
+            if (error == SSL_ERROR_WANT_READ) {
+                events = POLLIN;
+            } else if (error == SSL_ERROR_WANT_WRITE) {
+                events = POLLOUT;
+            } else if (error == SSL_ERROR_SYSCALL && errno == EINTR) {
+                continue;
+            } else {
+                result = -1;
+                break;
+            }
+
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                result = -1;
+                break;
+            }
+            pollfd pfd{fd, events, 0};
+            int ready = ::poll(&pfd, 1, static_cast<int>(left.count()));
+            if (ready < 0 && errno != EINTR) {
+                result = -1;
+                break;
+            }
+        }
+
+        // HTTP/1.1 is served with blocking I/O; HTTP/2 makes the socket
+        // non-blocking again once it takes the connection over
+        if (fcntl(fd, F_SETFL, flags) < 0) {
+            result = -1;
+        }
+        return result;
+    }
+}
+
+TlsContext::TlsContext(const TlsConfig& config)
+    : config(config),
+      alpn_wire(to_alpn_wire(config.alpn, true)),
+      alpn_wire_h1(to_alpn_wire(config.alpn, false)) {
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        throw std::runtime_error("Failed to create TLS context: " + openssl_error());
+    }
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    uint64_t options = SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef CPPWEB_HAVE_KTLS
+    if (config.enable_ktls) {
+        options |= SSL_OP_ENABLE_KTLS;
+    }
+#endif
+    if (!config.session_tickets) {
+        options |= SSL_OP_NO_TICKET;
+        SSL_CTX_set_num_tickets(ctx, 0);
+    }
+    SSL_CTX_set_options(ctx, options);
+
+    if (!config.ciphers.empty() && SSL_CTX_set_cipher_list(ctx, config.ciphers.c_str()) != 1) {
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("Invalid TLS cipher list: " + openssl_error());
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, config.cert_file.c_str()) != 1) {
+        std::string error = openssl_error();
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("Failed to load certificate " + config.cert_file + ": " + error);
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx, config.key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        std::string error = openssl_error();
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("Failed to load private key " + config.key_file + ": " + error);
+    }
+
+    // Stateful resumption: one cache in the context, shared by every worker
+    static const unsigned char session_context[] = "cppweb";
+    SSL_CTX_set_session_id_context(ctx, session_context, sizeof(session_context) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, static_cast<long>(config.session_cache_size));
+    SSL_CTX_set_timeout(ctx, static_cast<long>(config.session_timeout.count()));
+
+    SSL_CTX_set_alpn_select_cb(ctx, &TlsContext::select_alpn, this);
+}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(ctx);
+}
+
+int TlsContext::select_alpn(ssl_st* ssl, const unsigned char** out, unsigned char* outlen,
+                            const unsigned char* in, unsigned int inlen, void*) {
+    const std::string* ours = static_cast<const std::string*>(SSL_get_app_data(ssl));
+    if (!ours) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    // Server preference: the first of our protocols the client also offers
+    for (size_t i = 0; i < ours->size(); i += 1 + static_cast<unsigned char>((*ours)[i])) {
+        unsigned char len = static_cast<unsigned char>((*ours)[i]);
+        const unsigned char* proto = reinterpret_cast<const unsigned char*>(ours->data() + i + 1);
+
+        for (unsigned int j = 0; j < inlen; j += 1u + in[j]) {
+            if (in[j] == len && j + 1u + len <= inlen && std::equal(proto, proto + len, in + j + 1)) {
+                *out = in + j + 1;
+                *outlen = len;
+                return SSL_TLSEXT_ERR_OK;
+            }
+        }
+    }
+    return SSL_TLSEXT_ERR_NOACK;
+}
+
+std::unique_ptr<TlsTransport> TlsContext::accept(int fd, bool allow_h2) {
+    SSL* ssl = SSL_new(ctx);
+    if (!ssl) {
+        failed_count.fetch_add(1, std::memory_order_relaxed);
+        ERR_clear_error();
+        return nullptr;
+    }
+    SSL_set_fd(ssl, fd);
+    SSL_set_app_data(ssl, allow_h2 ? &alpn_wire : &alpn_wire_h1);
+
+    // A client that stalls or trickles the handshake must not hold a worker
+    // for longer than handshake_timeout in total
+    int result = accept_with_deadline(ssl, fd, config.handshake_timeout);
+
+    if (result != 1) {
+        failed_count.fetch_add(1, std::memory_order_relaxed);
+        ERR_clear_error();
+        SSL_free(ssl);
+        return nullptr;
+    }
+
+    auto transport = std::make_unique<TlsTransport>(fd, ssl);
+    handshake_count.fetch_add(1, std::memory_order_relaxed);
+    if (transport->session_reused()) {
+        resumed_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (transport->ktls_send()) {
+        ktls_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    return transport;
+}
+
+TlsTransport::TlsTransport(int fd, ssl_st* ssl) : Transport(fd), ssl(ssl) {
+#ifdef CPPWEB_HAVE_KTLS
+    ktls_send_enabled = BIO_get_ktls_send(SSL_get_wbio(ssl));
+#endif
+}
+
+TlsTransport::~TlsTransport() {
+    if (!failed) {
+        ERR_clear_error();
+        SSL_shutdown(ssl); // Send close_notify; do not wait for the peer's
+    }
+    SSL_free(ssl);
+    ERR_clear_error();
+}
+
+ssize_t TlsTransport::read(void* buffer, size_t len) {
+    while (true) {
+        ERR_clear_error();
+        int n = SSL_read(ssl, buffer, static_cast<int>(len > INT32_MAX ? INT32_MAX : len));
+        if (n > 0) {
+            return n;
+        }
+
+        int error = SSL_get_error(ssl, n);
+        if (error == SSL_ERROR_ZERO_RETURN) {
+            return 0;
+        }
+        if (error == SSL_ERROR_WANT_READ) {
+            // Non-blocking socket and no complete record yet
+            errno = EAGAIN;
+            return -1;
+        }
+        if (wait_for_retry(fd(), error)) {
+            continue;
+        }
+        failed = true;
+        return -1;
+    }
+}
+
+ssize_t TlsTransport::write(const void* data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    while (true) {
+        ERR_clear_error();
+        int n = SSL_write(ssl, data, static_cast<int>(len > INT32_MAX ? INT32_MAX : len));
+        if (n > 0) {
+            return n;
+        }
+        // On a non-blocking socket the retry repeats the same buffer, as OpenSSL requires
+        if (wait_for_retry(fd(), SSL_get_error(ssl, n))) {
+            continue;
+        }
+        failed = true;
+        return -1;
+    }
+}
+
+ssize_t TlsTransport::writev(const iovec* iov, int count) {
+    // A buffer of a full record or more is encrypted from where it is; only
+    // small ones are gathered, so a header shares a record with its body
+    if (count > 0 && iov[0].iov_len >= kMaxRecordSize) {
+        return write(iov[0].iov_base, iov[0].iov_len);
+    }
+    return Transport::writev(iov, count);
+}
+
+ssize_t TlsTransport::send_file(int file_fd, off_t offset, size_t count) {
+#ifdef CPPWEB_HAVE_KTLS
+    if (ktls_send_enabled) {
+        while (true) {
+            ERR_clear_error();
+            ossl_ssize_t n = SSL_sendfile(ssl, file_fd, offset, count, 0);
+            if (n >= 0) {
+                return n;
+            }
+            if (wait_for_retry(fd(), SSL_get_error(ssl, static_cast<int>(n)))) {
+                continue;
+            }
+            failed = true;
+            return -1;
+        }
+    }
+#endif
+    return send_file_buffered(*this, file_fd, offset, count);
+}
+
+bool TlsTransport::has_buffered_input() const {
+    return SSL_pending(ssl) > 0;
+}
+
+std::string TlsTransport::negotiated_protocol() const {
+    const unsigned char* proto = nullptr;
+    unsigned int len = 0;
+    SSL_get0_alpn_selected(ssl, &proto, &len);
+    return proto ? std::string(reinterpret_cast<const char*>(proto), len) : std::string();
+}
+
+bool TlsTransport::session_reused() const {
+    return SSL_session_reused(ssl) == 1;
+}
+
+} // namespace cppweb::net
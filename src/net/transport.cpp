@@ -0,0 +1,156 @@
+#include "../../include/cppweb/net/transport.hpp"
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace cppweb::net {
+
+bool Transport::write_all(const void* data, size_t len) {
+    const char* ptr = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t sent = write(ptr, len);
+        if (sent <= 0) {
+            return false;
+        }
+        ptr += sent;
+        len -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+ssize_t Transport::writev(const iovec* iov, int count) {
+    char buffer[16384];
+    size_t used = 0;
+    for (int i = 0; i < count && used < sizeof(buffer); ++i) {
+        size_t take = std::min(iov[i].iov_len, sizeof(buffer) - used);
+        std::memcpy(buffer + used, iov[i].iov_base, take);
+        used += take;
+    }
+    return write(buffer, used);
+}
+
+bool Transport::writev_all(iovec* iov, size_t count) {
+    size_t index = 0;
+    while (true) {
+        while (index < count && iov[index].iov_len == 0) {
+            ++index;
+        }
+        if (index == count) {
+            return true;
+        }
+
+        ssize_t sent = writev(iov + index, static_cast<int>(std::min<size_t>(count - index, IOV_MAX)));
+        if (sent <= 0) {
+            return false;
+        }
+
+        size_t left = static_cast<size_t>(sent);
+        while (left > 0) {
+            size_t step = std::min(left, iov[index].iov_len);
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + step;
+            iov[index].iov_len -= step;
+            left -= step;
+            if (iov[index].iov_len == 0) {
+                ++index;
+            }
+        }
+    }
+}
+
+bool Transport::writev_all(iovec* iov, const FileSource* files, size_t count) {
+    if (writes_mapped_memory()) {
+        return writev_all(iov, count);
+    }
+
+    size_t run = 0; // first buffer not yet written
+    for (size_t i = 0; i < count; ++i) {
+        if (files[i].fd < 0) {
+            continue;
+        }
+        if (i > run && !writev_all(iov + run, i - run)) {
+            return false;
+        }
+        if (send_file_all(files[i].fd, static_cast<off_t>(files[i].offset), iov[i].iov_len) != iov[i].iov_len) {
+            return false; // The file shrank or could not be read
+        }
+        run = i + 1;
+    }
+    return count == run || writev_all(iov + run, count - run);
+}
+
+uint64_t Transport::send_file_all(int file_fd, off_t offset, uint64_t count) {
+    uint64_t total = 0;
+    while (total < count) {
+        ssize_t sent = send_file(file_fd, offset + static_cast<off_t>(total), static_cast<size_t>(count - total));
+        if (sent <= 0) {
+            break; // Error, or the file is shorter than expected
+        }
+        total += static_cast<uint64_t>(sent);
+    }
+    return total;
+}
+
+ssize_t PlainTransport::read(void* buffer, size_t len) {
+    ssize_t n;
+    do {
+        n = ::read(fd(), buffer, len);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+ssize_t PlainTransport::write(const void* data, size_t len) {
+    ssize_t n;
+    do {
+        n = ::send(fd(), data, len, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+ssize_t PlainTransport::writev(const iovec* iov, int count) {
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = static_cast<size_t>(count);
+    ssize_t n;
+    do {
+        n = ::sendmsg(fd(), &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+ssize_t PlainTransport::send_file(int file_fd, off_t offset, size_t count) {
+    off_t pos = offset;
+    ssize_t n;
+    do {
+        n = ::sendfile(fd(), file_fd, &pos, count);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        // The file type does not support sendfile
+        return send_file_buffered(*this, file_fd, offset, count);
+    }
+    return n;
+}
+
+ssize_t send_file_buffered(Transport& transport, int file_fd, off_t offset, size_t count) {
+    char buffer[16384];
+    size_t chunk = count < sizeof(buffer) ? count : sizeof(buffer);
+
+    ssize_t n;
+    do {
+        n = ::pread(file_fd, buffer, chunk, offset);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return -1;
+    }
+    return transport.write_all(buffer, static_cast<size_t>(n)) ? n : -1;
+}
+
+} // namespace cppweb::net
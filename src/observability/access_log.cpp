@@ -0,0 +1,315 @@
+#include "../../include/cppweb/observability/access_log.hpp"
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+namespace cppweb::observability {
+
+namespace {
+
+    // The writer sleeps on a futex rather than a condition variable, so a
+    // producer waking it takes no lock, its own or glibc's
+    void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::milliseconds timeout) {
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+        ts.tv_nsec = static_cast<long>((timeout.count() % 1000) * 1000000);
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+    }
+
+    void futex_wake(std::atomic<uint32_t>& word) {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    const char* or_dash(const char* value) {
+        return value[0] != '\0' ? value : "-";
+    }
+
+    void append_uint(std::string& out, uint64_t value) {
+        char digits[24];
+        int len = 0;
+        do {
+            digits[len++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (len > 0) {
+            out += digits[--len];
+        }
+    }
+
+    // Escapes a field for use inside a double-quoted log or JSON string
+    void append_quoted(std::string& out, const char* value, bool json) {
+        out += '"';
+        for (const char* p = value; *p; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += *p;
+            } else if (c < 0x20 || c == 0x7f) {
+                static const char hex[] = "0123456789abcdef";
+                out += json ? "\\u00" : "\\x";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+            } else {
+                out += *p;
+            }
+        }
+        out += '"';
+    }
+
+    // Formatting the date dominates the cost of a line, so the writer thread
+    // keeps the last rendered second around.
+    struct TimeCache {
+        int64_t second = -1;
+        char clf[32] = {};  // 10/Oct/2000:13:55:36 +0000
+        char iso[24] = {};  // 2000-10-10T13:55:36
+
+        void update(int64_t timestamp_us) {
+            int64_t sec = timestamp_us / 1000000;
+            if (sec == second) return;
+            second = sec;
+            time_t t = static_cast<time_t>(sec);
+            struct tm parts;
+            gmtime_r(&t, &parts);
+            strftime(clf, sizeof(clf), "%d/%b/%Y:%H:%M:%S +0000", &parts);
+            strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S", &parts);
+        }
+    };
+
+    thread_local TimeCache time_cache;
+}
+
+/**
+ * Single-producer single-consumer ring. The owning request thread advances
+ * head, the writer thread advances tail; each side only reads the other's
+ * index, so neither ever waits.
+ */
+class AccessLog::Ring {
+public:
+    explicit Ring(size_t capacity) : slots(capacity) {}
+
+    bool push(const AccessRecord& record, bool& crossed_half) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        if (h - t >= slots.size()) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h % slots.size()] = record;
+        head.store(h + 1, std::memory_order_release);
+        crossed_half = (h + 1 - t) == slots.size() / 2;
+        return true;
+    }
+
+    template<typename F>
+    size_t consume(F&& visit) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (uint64_t i = t; i < h; ++i) {
+            visit(slots[i % slots.size()]);
+        }
+        tail.store(h, std::memory_order_release);
+        return static_cast<size_t>(h - t);
+    }
+
+    std::atomic<uint64_t> dropped{0};
+
+private:
+    std::vector<AccessRecord> slots;
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+};
+
+AccessLog::AccessLog(AccessLogConfig config)
+    : config(std::move(config)) {
+    if (this->config.path.empty()) {
+        fd = STDERR_FILENO;
+    } else {
+        fd = ::open(this->config.path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open access log " + this->config.path + ": " + std::strerror(errno));
+        }
+        owns_fd = true;
+    }
+
+    writer = std::thread([this] { writer_loop(); });
+}
+
+AccessLog::~AccessLog() {
+    stopping.store(true);
+    wake_writer();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (owns_fd) {
+        ::close(fd);
+    }
+}
+
+AccessLog::Ring& AccessLog::local_ring() {
+    return rings.local([this](size_t) {
+        return std::make_unique<Ring>(std::max<size_t>(config.ring_capacity, 2));
+    });
+}
+
+bool AccessLog::log(const AccessRecord& record) {
+    bool crossed_half = false;
+    bool queued = local_ring().push(record, crossed_half);
+    if (crossed_half) {
+        // Wake the writer early instead of waiting out the flush interval
+        wake_writer();
+    }
+    return queued;
+}
+
+void AccessLog::wake_writer() {
+    // Pairs with writer_loop(): either the writer sees the new sequence
+    // before it sleeps, or this sees it sleeping. A wake racing the sleep
+    // finds the sequence changed and returns at once.
+    wake_seq.fetch_add(1);
+    if (writer_sleeping.load()) {
+        futex_wake(wake_seq);
+    }
+}
+
+uint64_t AccessLog::dropped() const {
+    uint64_t total = 0;
+    rings.for_each([&total](const Ring& ring) {
+        total += ring.dropped.load(std::memory_order_relaxed);
+    });
+    return total;
+}
+
+void AccessLog::format_record(const AccessRecord& record, AccessLogFormat format, std::string& out) {
+    time_cache.update(record.timestamp_us);
+
+    if (format == AccessLogFormat::JsonLines) {
+        out += "{\"time\":\"";
+        out += time_cache.iso;
+        char millis[8];
+        std::snprintf(millis, sizeof(millis), ".%03dZ", static_cast<int>((record.timestamp_us / 1000) % 1000));
+        out += millis;
+        out += "\",\"remote\":";
+        append_quoted(out, record.remote, true);
+        out += ",\"method\":";
+        append_quoted(out, record.method, true);
+        out += ",\"path\":";
+        append_quoted(out, record.path, true);
+        out += ",\"protocol\":";
+        append_quoted(out, record.protocol, true);
+        out += ",\"status\":";
+        append_uint(out, static_cast<uint64_t>(record.status_code));
+        out += ",\"bytes_in\":";
+        append_uint(out, record.bytes_in);
+        out += ",\"bytes_out\":";
+        append_uint(out, record.bytes_out);
+        out += ",\"latency_us\":";
+        append_uint(out, record.latency_ns / 1000);
+        out += ",\"referer\":";
+        append_quoted(out, record.referer, true);
+        out += ",\"user_agent\":";
+        append_quoted(out, record.user_agent, true);
+        out += "}\n";
+        return;
+    }
+
+    out += or_dash(record.remote);
+    out += " - - [";
+    out += time_cache.clf;
+    out += "] \"";
+    out += record.method;
+    out += ' ';
+    for (const char* p = record.path; *p; ++p) {
+        // Keep the request line unambiguous for log parsers
+        unsigned char c = static_cast<unsigned char>(*p);
+        out += (c < 0x20 || c == '"' || c == 0x7f) ? '?' : *p;
+    }
+    out += ' ';
+    out += record.protocol;
+    out += "\" ";
+    append_uint(out, static_cast<uint64_t>(record.status_code));
+    out += ' ';
+    if (record.bytes_out == 0) {
+        out += '-';
+    } else {
+        append_uint(out, record.bytes_out);
+    }
+
+    if (format == AccessLogFormat::Combined) {
+        out += ' ';
+        append_quoted(out, or_dash(record.referer), false);
+        out += ' ';
+        append_quoted(out, or_dash(record.user_agent), false);
+    }
+    out += '\n';
+}
+
+size_t AccessLog::drain(std::string& buffer, size_t& buffered) {
+    // Rings are only freed with the log, so consuming outside the lock is safe
+    std::vector<Ring*> snapshot;
+    rings.for_each([&snapshot](Ring& ring) {
+        snapshot.push_back(&ring);
+    });
+
+    size_t count = 0;
+    for (Ring* ring : snapshot) {
+        count += ring->consume([&](const AccessRecord& record) {
+            format_record(record, config.format, buffer);
+            ++buffered;
+            if (buffer.size() >= config.write_buffer_bytes) {
+                write_out(buffer, buffered);
+            }
+        });
+    }
+    return count;
+}
+
+void AccessLog::write_out(std::string& buffer, size_t& buffered) {
+    const char* ptr = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, ptr, remaining);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // Nowhere to report to; drop the batch rather than spin
+        }
+        ptr += n;
+        remaining -= static_cast<size_t>(n);
+    }
+    (remaining == 0 ? written_count : failed_count).fetch_add(buffered, std::memory_order_relaxed);
+    buffered = 0;
+    buffer.clear();
+}
+
+void AccessLog::writer_loop() {
+    std::string buffer;
+    buffer.reserve(config.write_buffer_bytes + 4096);
+    size_t buffered = 0;
+
+    while (true) {
+        // Sequence first: a stop that bumped it is then seen in last_round
+        uint32_t seen = wake_seq.load();
+        bool last_round = stopping.load();
+        drain(buffer, buffered);
+        if (!buffer.empty()) {
+            write_out(buffer, buffered);
+        }
+        if (last_round) {
+            break;
+        }
+
+        writer_sleeping.store(true);
+        if (wake_seq.load() == seen) {
+            futex_wait(wake_seq, seen, config.flush_interval);
+        }
+        writer_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+} // namespace cppweb::observability
@@ -0,0 +1,337 @@
+#include "../../include/cppweb/observability/metrics.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace cppweb::observability {
+
+namespace {
+    // Prometheus bucket bounds in seconds, shared by every exported histogram
+    constexpr double kPrometheusBounds[] = {
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+        0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+    };
+
+    const char* const kStatusClasses[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+    const char* const kMethodLabels[kHttpMethodCount] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "OTHER"
+    };
+
+    std::string escape_label(const std::string& value) {
+        std::string out;
+        out.reserve(value.size());
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    void write_histogram(std::ostringstream& out, const std::string& name,
+                         const std::string& labels, const LatencyHistogram& hist) {
+        std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+        for (double bound : kPrometheusBounds) {
+            uint64_t bound_ns = static_cast<uint64_t>(bound * 1e9);
+            out << name << "_bucket" << prefix << "le=\"" << bound << "\"} "
+                << hist.count_at_or_below(bound_ns) << "\n";
+        }
+        out << name << "_bucket" << prefix << "le=\"+Inf\"} " << hist.count() << "\n";
+        std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+        out << name << "_sum" << suffix << " " << static_cast<double>(hist.sum()) / 1e9 << "\n";
+        out << name << "_count" << suffix << " " << hist.count() << "\n";
+    }
+}
+
+HttpMethod classify_method(const std::string& method) {
+    for (size_t i = 0; i + 1 < kHttpMethodCount; ++i) {
+        if (method == kMethodLabels[i]) {
+            return static_cast<HttpMethod>(i);
+        }
+    }
+    return HttpMethod::Other;
+}
+
+const char* method_label(HttpMethod method) {
+    return kMethodLabels[static_cast<size_t>(method)];
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value_ns) {
+    constexpr uint64_t max_value = (uint64_t(1) << kMaxValueBits) - 1;
+    if (value_ns > max_value) {
+        value_ns = max_value;
+    }
+    if (value_ns < kSubBucketCount) {
+        return static_cast<size_t>(value_ns);
+    }
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value_ns));
+    unsigned shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBucketCount + ((value_ns >> shift) & (kSubBucketCount - 1));
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(size_t index) {
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / kSubBucketCount) - 1;
+    uint64_t sub = index % kSubBucketCount;
+    return (kSubBucketCount + sub) << shift;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / kSubBucketCount) - 1;
+    uint64_t sub = index % kSubBucketCount;
+    return ((kSubBucketCount + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_ns) {
+    ++buckets[bucket_index(value_ns)];
+    ++total_count;
+    total_sum += value_ns;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    total_count += other.total_count;
+    total_sum += other.total_sum;
+}
+
+uint64_t LatencyHistogram::count_at_or_below(uint64_t bound_ns) const {
+    uint64_t result = 0;
+    for (size_t i = 0; i < kBucketCount && bucket_upper_bound(i) <= bound_ns; ++i) {
+        result += buckets[i];
+    }
+    return result;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (total_count == 0) {
+        return 0;
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total_count));
+    target = std::max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return bucket_upper_bound(i);
+        }
+    }
+    return bucket_upper_bound(kBucketCount - 1);
+}
+
+void RouteStats::merge(const RouteStats& other) {
+    requests += other.requests;
+    for (size_t i = 0; i < status_classes.size(); ++i) {
+        status_classes[i] += other.status_classes[i];
+    }
+    bytes_in += other.bytes_in;
+    bytes_out += other.bytes_out;
+    handler_latency.merge(other.handler_latency);
+    total_latency.merge(other.total_latency);
+}
+
+MetricsRegistry::MetricsRegistry() = default;
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+MetricsRegistry::ThreadShard& MetricsRegistry::local_shard() {
+    return shards.local([](size_t) { return std::make_unique<ThreadShard>(); });
+}
+
+void MetricsRegistry::record_request(const RequestSample& sample) {
+    // Classified before taking the lock; the label set is fixed
+    size_t method = static_cast<size_t>(classify_method(sample.method));
+    ThreadShard& shard = local_shard();
+    std::unique_lock<std::mutex> lock(shard.mutex);
+
+    if (sample.queue_wait_ns) {
+        shard.queue_wait.record(*sample.queue_wait_ns);
+    }
+    if (sample.connection_closed) {
+        ++shard.connections_closed;
+    }
+
+    RouteStats& stats = shard.routes[method][sample.route];
+    ++stats.requests;
+    int status_class = sample.status_code / 100;
+    if (status_class >= 1 && status_class <= 5) {
+        ++stats.status_classes[status_class - 1];
+    }
+    stats.bytes_in += sample.bytes_in;
+    stats.bytes_out += sample.bytes_out;
+    stats.handler_latency.record(sample.handler_ns);
+    stats.total_latency.record(sample.total_ns);
+}
+
+void MetricsRegistry::record_queue_wait(uint64_t wait_ns) {
+    ThreadShard& shard = local_shard();
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    shard.queue_wait.record(wait_ns);
+}
+
+void MetricsRegistry::connection_opened() {
+    connections_opened.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::connection_closed() {
+    connection_closed(nullptr);
+}
+
+void MetricsRegistry::connection_closed(const uint64_t* queue_wait_ns) {
+    ThreadShard& shard = local_shard();
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (queue_wait_ns) {
+        shard.queue_wait.record(*queue_wait_ns);
+    }
+    ++shard.connections_closed;
+}
+
+void MetricsRegistry::record_pool_resize(size_t old_count, size_t new_count) {
+    ThreadShard& shard = local_shard();
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (new_count > old_count) {
+        shard.workers_started += new_count - old_count;
+    } else {
+        shard.workers_retired += old_count - new_count;
+    }
+}
+
+void MetricsRegistry::set_pool_probes(std::function<size_t()> queue_depth, std::function<size_t()> worker_count) {
+    std::unique_lock<std::mutex> lock(probes_mutex);
+    queue_depth_probe = std::move(queue_depth);
+    worker_count_probe = std::move(worker_count);
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+    MetricsSnapshot snap;
+
+    shards.for_each([&snap](ThreadShard& shard) {
+        std::unique_lock<std::mutex> shard_lock(shard.mutex);
+        for (size_t method = 0; method < kHttpMethodCount; ++method) {
+            const auto& routes = shard.routes[method];
+            if (routes.empty()) continue;
+            auto& merged = snap.routes[kMethodLabels[method]];
+            for (const auto& [route, stats] : routes) {
+                merged[route].merge(stats);
+            }
+        }
+        snap.queue_wait.merge(shard.queue_wait);
+        snap.connections_closed += shard.connections_closed;
+        snap.workers_started += shard.workers_started;
+        snap.workers_retired += shard.workers_retired;
+    });
+
+    // Read after the shards, so a close is never seen without its open
+    snap.connections_opened = connections_opened.load(std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(probes_mutex);
+    if (queue_depth_probe) {
+        snap.queue_depth = queue_depth_probe();
+    }
+    if (worker_count_probe) {
+        snap.worker_count = worker_count_probe();
+    }
+    return snap;
+}
+
+size_t MetricsRegistry::shard_count() const {
+    return shards.size();
+}
+
+std::string MetricsRegistry::render_prometheus() const {
+    MetricsSnapshot snap = snapshot();
+    std::ostringstream out;
+    out.precision(12);
+
+    out << "# HELP cppweb_http_requests_total Completed HTTP requests.\n"
+        << "# TYPE cppweb_http_requests_total counter\n";
+    for (const auto& [method, routes] : snap.routes) {
+        for (const auto& [route, stats] : routes) {
+            for (size_t i = 0; i < stats.status_classes.size(); ++i) {
+                if (stats.status_classes[i] == 0) continue;
+                out << "cppweb_http_requests_total{method=\"" << escape_label(method)
+                    << "\",route=\"" << escape_label(route)
+                    << "\",status_class=\"" << kStatusClasses[i] << "\"} "
+                    << stats.status_classes[i] << "\n";
+            }
+        }
+    }
+
+    out << "# HELP cppweb_http_request_bytes_total Bytes read for HTTP requests.\n"
+        << "# TYPE cppweb_http_request_bytes_total counter\n";
+    for (const auto& [method, routes] : snap.routes) {
+        for (const auto& [route, stats] : routes) {
+            out << "cppweb_http_request_bytes_total{method=\"" << escape_label(method)
+                << "\",route=\"" << escape_label(route) << "\"} " << stats.bytes_in << "\n";
+        }
+    }
+
+    out << "# HELP cppweb_http_response_bytes_total Bytes written for HTTP responses.\n"
+        << "# TYPE cppweb_http_response_bytes_total counter\n";
+    for (const auto& [method, routes] : snap.routes) {
+        for (const auto& [route, stats] : routes) {
+            out << "cppweb_http_response_bytes_total{method=\"" << escape_label(method)
+                << "\",route=\"" << escape_label(route) << "\"} " << stats.bytes_out << "\n";
+        }
+    }
+
+    out << "# HELP cppweb_http_handler_duration_seconds Time spent inside route handlers.\n"
+        << "# TYPE cppweb_http_handler_duration_seconds histogram\n";
+    for (const auto& [method, routes] : snap.routes) {
+        for (const auto& [route, stats] : routes) {
+            std::string labels = "method=\"" + escape_label(method) + "\",route=\"" + escape_label(route) + "\"";
+            write_histogram(out, "cppweb_http_handler_duration_seconds", labels, stats.handler_latency);
+        }
+    }
+
+    out << "# HELP cppweb_http_request_duration_seconds Time from accept to response sent.\n"
+        << "# TYPE cppweb_http_request_duration_seconds histogram\n";
+    for (const auto& [method, routes] : snap.routes) {
+        for (const auto& [route, stats] : routes) {
+            std::string labels = "method=\"" + escape_label(method) + "\",route=\"" + escape_label(route) + "\"";
+            write_histogram(out, "cppweb_http_request_duration_seconds", labels, stats.total_latency);
+        }
+    }
+
+    out << "# HELP cppweb_threadpool_queue_wait_seconds Time tasks spent queued before a worker picked them up.\n"
+        << "# TYPE cppweb_threadpool_queue_wait_seconds histogram\n";
+    write_histogram(out, "cppweb_threadpool_queue_wait_seconds", "", snap.queue_wait);
+
+    out << "# HELP cppweb_threadpool_queue_depth Tasks waiting in the thread pool queue.\n"
+        << "# TYPE cppweb_threadpool_queue_depth gauge\n"
+        << "cppweb_threadpool_queue_depth " << snap.queue_depth << "\n";
+
+    out << "# HELP cppweb_threadpool_workers Worker threads in the thread pool.\n"
+        << "# TYPE cppweb_threadpool_workers gauge\n"
+        << "cppweb_threadpool_workers " << snap.worker_count << "\n";
+
+    out << "# HELP cppweb_threadpool_resizes_total Workers added or retired by an elastic thread pool.\n"
+        << "# TYPE cppweb_threadpool_resizes_total counter\n"
+        << "cppweb_threadpool_resizes_total{direction=\"grow\"} " << snap.workers_started << "\n"
+        << "cppweb_threadpool_resizes_total{direction=\"shrink\"} " << snap.workers_retired << "\n";
+
+    out << "# HELP cppweb_connections_total Accepted client connections.\n"
+        << "# TYPE cppweb_connections_total counter\n"
+        << "cppweb_connections_total " << snap.connections_opened << "\n";
+
+    out << "# HELP cppweb_active_connections Client connections currently open.\n"
+        << "# TYPE cppweb_active_connections gauge\n"
+        << "cppweb_active_connections " << snap.active_connections() << "\n";
+
+    return out.str();
+}
+
+} // namespace cppweb::observability
@@ -0,0 +1,242 @@
+#include "../../include/cppweb/observability/tracer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace cppweb::observability {
+
+namespace {
+    constexpr size_t kLabelWords = TraceEvent::kLabelSize / sizeof(uint64_t);
+    constexpr size_t kWords = 4 + kLabelWords;
+
+    size_t round_up_pow2(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // xorshift64*, one state per thread; good enough for sampling decisions
+    uint64_t next_random() {
+        thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(&state);
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    void write_json_string(std::ostream& out, const char* value) {
+        out << '"';
+        for (const char* p = value; *p; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\') {
+                out << '\\' << *p;
+            } else if (c < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+            } else {
+                out << *p;
+            }
+        }
+        out << '"';
+    }
+
+    void write_micros(std::ostream& out, uint64_t ns) {
+        out << ns / 1000 << '.';
+        uint64_t frac = ns % 1000;
+        out << static_cast<char>('0' + frac / 100)
+            << static_cast<char>('0' + (frac / 10) % 10)
+            << static_cast<char>('0' + frac % 10);
+    }
+}
+
+const char* trace_phase_name(TracePhase phase) {
+    switch (phase) {
+        case TracePhase::Accept:    return "accept";
+        case TracePhase::QueueWait: return "queue_wait";
+        case TracePhase::Read:      return "read";
+        case TracePhase::Parse:     return "parse";
+        case TracePhase::Handler:   return "handler";
+        case TracePhase::Send:      return "send";
+        case TracePhase::Request:   return "request";
+        default:                    return "unknown";
+    }
+}
+
+/**
+ * Single-producer ring: only the owning thread writes, any thread may read.
+ * Each slot carries a sequence number that is odd while the slot is being
+ * written and 2 * position + 2 once it holds the event for that position.
+ */
+class Tracer::Ring {
+public:
+    Ring(uint32_t index, size_t capacity) : index(index), mask(capacity - 1), slots(capacity) {}
+
+    void push(const uint64_t (&words)[kWords]) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & mask];
+
+        slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.seq.store(2 * pos + 2, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_release);
+    }
+
+    void read_into(std::vector<TraceEvent>& out) const {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > slots.size() ? end - slots.size() : 0;
+
+        for (uint64_t pos = begin; pos < end; ++pos) {
+            const Slot& slot = slots[pos & mask];
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if (before != 2 * pos + 2) continue; // overwritten or mid-write
+
+            uint64_t words[kWords];
+            for (size_t i = 0; i < kWords; ++i) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != before) continue;
+
+            TraceEvent event;
+            event.request_id = words[0];
+            event.start_ns = words[1];
+            event.end_ns = words[2];
+            event.phase = static_cast<TracePhase>(words[3] & 0xff);
+            event.status_code = static_cast<int>(words[3] >> 8);
+            event.thread_index = index;
+            std::memcpy(event.label, &words[4], sizeof(event.label));
+            event.label[sizeof(event.label) - 1] = '\0';
+            out.push_back(event);
+        }
+    }
+
+    const uint32_t index;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> words[kWords] = {};
+    };
+
+    const uint64_t mask;
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> head{0};
+};
+
+Tracer::Tracer(size_t ring_capacity)
+    : ring_capacity(round_up_pow2(std::max<size_t>(ring_capacity, 2))) {}
+
+Tracer::~Tracer() = default;
+
+void Tracer::set_sample_rate(double rate) {
+    rate = std::clamp(rate, 0.0, 1.0);
+    uint64_t threshold = rate >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(rate * 18446744073709551616.0);
+    sample_threshold.store(threshold, std::memory_order_relaxed);
+}
+
+double Tracer::get_sample_rate() const {
+    uint64_t threshold = sample_threshold.load(std::memory_order_relaxed);
+    return threshold == UINT64_MAX ? 1.0 : static_cast<double>(threshold) / 18446744073709551616.0;
+}
+
+uint64_t Tracer::sample() {
+    uint64_t threshold = sample_threshold.load(std::memory_order_relaxed);
+    if (threshold == 0) {
+        return 0;
+    }
+    if (threshold != UINT64_MAX && next_random() >= threshold) {
+        return 0;
+    }
+    return next_request_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+Tracer::Ring& Tracer::local_ring() {
+    return rings.local([this](size_t index) {
+        return std::make_unique<Ring>(static_cast<uint32_t>(index + 1), ring_capacity);
+    });
+}
+
+void Tracer::record(uint64_t request_id, TracePhase phase, uint64_t start_ns, uint64_t end_ns,
+                    const std::string& label, int status_code) {
+    if (request_id == 0) {
+        return;
+    }
+
+    uint64_t words[kWords] = {};
+    words[0] = request_id;
+    words[1] = start_ns;
+    words[2] = end_ns;
+    words[3] = static_cast<uint64_t>(phase) | (static_cast<uint64_t>(static_cast<uint32_t>(status_code)) << 8);
+    std::memcpy(&words[4], label.data(), std::min(label.size(), TraceEvent::kLabelSize - 1));
+
+    local_ring().push(words);
+}
+
+std::vector<TraceEvent> Tracer::collect() const {
+    std::vector<TraceEvent> events;
+    rings.for_each([&events](const Ring& ring) {
+        ring.read_into(events);
+    });
+
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.start_ns < b.start_ns;
+    });
+    return events;
+}
+
+size_t Tracer::ring_count() const {
+    return rings.size();
+}
+
+void Tracer::write_chrome_json(std::ostream& out) const {
+    std::vector<TraceEvent> events = collect();
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    std::vector<uint32_t> threads;
+    for (const auto& event : events) {
+        if (std::find(threads.begin(), threads.end(), event.thread_index) == threads.end()) {
+            threads.push_back(event.thread_index);
+        }
+    }
+    for (uint32_t thread : threads) {
+        out << (first ? "" : ",")
+            << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"cppweb-" << thread << "\"}}";
+        first = false;
+    }
+
+    for (const auto& event : events) {
+        out << (first ? "" : ",") << "\n{\"name\":\"" << trace_phase_name(event.phase)
+            << "\",\"cat\":\"http\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_index << ",\"ts\":";
+        write_micros(out, event.start_ns);
+        out << ",\"dur\":";
+        write_micros(out, event.end_ns >= event.start_ns ? event.end_ns - event.start_ns : 0);
+        out << ",\"args\":{\"request_id\":" << event.request_id;
+        if (event.status_code != 0) {
+            out << ",\"status\":" << event.status_code;
+        }
+        if (event.label[0] != '\0') {
+            out << ",\"label\":";
+            write_json_string(out, event.label);
+        }
+        out << "}}";
+        first = false;
+    }
+
+    out << "\n]}\n";
+}
+
+std::string Tracer::export_chrome_json() const {
+    std::ostringstream out;
+    write_chrome_json(out);
+    return out.str();
+}
+
+} // namespace cppweb::observability
@@ -26,7 +26,7 @@ void Router::del(const std::string& path, RouteHandler handler) {
     delete_routes[path] = handler;
 }
 
-void Router::route(const Request& req, Response& res) const {
+bool Router::route(const Request& req, Response& res) const {
     RouteHandler handler;
     bool route_found = false;
 
@@ -50,11 +50,13 @@ void Router::route(const Request& req, Response& res) const {
 
     if (route_found && handler) {
         handler(req, res); // Execution now happens safely outside the mutex lock
-    } else {
-        res.status_code = 404;
-        res.body = "404 Not Found";
-        res.content_type = "text/plain";
+        return true;
     }
+
+    res.status_code = 404;
+    res.body = "404 Not Found";
+    res.content_type = "text/plain";
+    return false;
 }
 
 bool Router::has_route(const std::string& method, const std::string& path) const {
@@ -77,6 +79,21 @@ size_t Router::route_count() const {
     return get_routes.size() + post_routes.size() + put_routes.size() + delete_routes.size();
 }
 
+void Router::set_executor(const std::string& method, const std::string& path, const std::string& executor) {
+    std::unique_lock<std::mutex> lock(routes_mutex);
+    if (executor.empty()) {
+        route_executors.erase({method, path});
+    } else {
+        route_executors[{method, path}] = executor;
+    }
+}
+
+std::string Router::executor_for(const std::string& method, const std::string& path) const {
+    std::unique_lock<std::mutex> lock(routes_mutex);
+    auto it = route_executors.find({method, path});
+    return it != route_executors.end() ? it->second : std::string();
+}
+
 std::map<std::string, RouteHandler>& Router::get_route_map(const std::string& method) {
     if (method == "GET") {
         return get_routes;
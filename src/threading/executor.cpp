@@ -0,0 +1,152 @@
+#include "../../include/cppweb/threading/executor.hpp"
+#include <stdexcept>
+
+namespace cppweb {
+namespace threading {
+
+Executor::Executor(std::string name, const ExecutorOptions& options)
+    : name_(std::move(name)), options_(options) {
+    if (options_.threads == 0) {
+        throw std::invalid_argument("Executor '" + name_ + "' needs at least one thread");
+    }
+    pool = std::make_unique<ThreadPool>(options_.threads);
+    if (options_.when_full == QueueFullPolicy::Block) {
+        timer = std::thread([this] { expire_parked(); });
+    }
+}
+
+Executor::~Executor() {
+    std::deque<Parked> dropped;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        dropped.swap(parked);
+    }
+    parked_changed.notify_all();
+    if (timer.joinable()) {
+        timer.join();
+    }
+    pool->shutdown();
+}
+
+Executor::Admission Executor::submit(std::function<void()> task, std::function<void()> on_timeout) {
+    submitted.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queued >= options_.max_queue) {
+            switch (options_.when_full) {
+                case QueueFullPolicy::CallerRuns:
+                    ran_on_caller.fetch_add(1, std::memory_order_relaxed);
+                    return Admission::CallerRuns;
+                case QueueFullPolicy::Block:
+                    if (on_timeout) {
+                        if (parked.size() >= options_.max_queue) {
+                            rejected.fetch_add(1, std::memory_order_relaxed);
+                            return Admission::Rejected;
+                        }
+                        // release_slot() hands the next free slot to the oldest parked task
+                        parked.push_back({std::move(task), std::move(on_timeout), Clock::now() + options_.block_timeout});
+                        if (parked.size() == 1) {
+                            parked_changed.notify_one();
+                        }
+                        return Admission::Queued;
+                    }
+                    if (slot_freed.wait_for(lock, options_.block_timeout,
+                                            [this] { return queued < options_.max_queue; })) {
+                        break;
+                    }
+                    rejected.fetch_add(1, std::memory_order_relaxed);
+                    return Admission::Rejected;
+                case QueueFullPolicy::Reject:
+                    rejected.fetch_add(1, std::memory_order_relaxed);
+                    return Admission::Rejected;
+            }
+        }
+        ++queued;
+    }
+
+    try {
+        start(std::move(task));
+    } catch (...) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            --queued;
+        }
+        slot_freed.notify_one();
+        throw;
+    }
+    return Admission::Queued;
+}
+
+void Executor::start(std::function<void()> task) {
+    // The caller has already taken a queue slot for the task
+    pool->enqueue([this, task = std::move(task)] {
+        release_slot();
+        task();
+    });
+}
+
+void Executor::release_slot() {
+    std::function<void()> next;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!parked.empty()) {
+            // The slot passes straight to the oldest parked task
+            next = std::move(parked.front().task);
+            parked.pop_front();
+        } else {
+            --queued;
+        }
+    }
+    if (!next) {
+        slot_freed.notify_one();
+        return;
+    }
+
+    try {
+        start(std::move(next));
+    } catch (...) {
+        // Shutting down: the parked task is dropped and its slot given back
+        std::unique_lock<std::mutex> lock(mutex);
+        --queued;
+    }
+}
+
+void Executor::expire_parked() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (parked.empty()) {
+            parked_changed.wait(lock);
+            continue;
+        }
+        Clock::time_point deadline = parked.front().deadline;
+        if (Clock::now() < deadline) {
+            parked_changed.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::function<void()> on_timeout = std::move(parked.front().on_timeout);
+        parked.pop_front();
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        lock.unlock();
+        on_timeout();
+        lock.lock();
+    }
+}
+
+ExecutorStats Executor::stats() const {
+    ExecutorStats stats;
+    stats.threads = pool->get_thread_count();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.queued = queued;
+        stats.waiting = parked.size();
+    }
+    stats.submitted = submitted.load(std::memory_order_relaxed);
+    stats.rejected = rejected.load(std::memory_order_relaxed);
+    stats.ran_on_caller = ran_on_caller.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace threading
+} // namespace cppweb
@@ -1,21 +1,49 @@
 #include "../../include/cppweb/threading/thread_pool.hpp"
+#include <algorithm>
 #include <iostream>
 
 namespace cppweb {
 namespace threading {
 
-ThreadPool::ThreadPool(size_t num_threads) {
+ThreadPool::ThreadPool(size_t num_threads) : elastic(false) {
+    options.min_threads = num_threads;
+    options.max_threads = num_threads;
+    std::unique_lock<std::mutex> lock(queue_mutex);
     for (size_t i = 0; i < num_threads; ++i) {
-        workers.emplace_back([this] { worker_thread(); });
+        start_worker();
     }
 }
 
+ThreadPool::ThreadPool(const PoolOptions& pool_options) : options(pool_options), elastic(true) {
+    if (options.max_threads == 0 || options.min_threads > options.max_threads) {
+        throw std::invalid_argument("ThreadPool needs 0 <= min_threads <= max_threads and max_threads > 0");
+    }
+    if (options.target_queue_wait.count() <= 0 || options.idle_timeout.count() <= 0) {
+        throw std::invalid_argument("ThreadPool target_queue_wait and idle_timeout must be positive");
+    }
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    for (size_t i = 0; i < options.min_threads; ++i) {
+        start_worker();
+    }
+    supervisor = std::thread([this] { supervise(); });
+}
+
 ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::shutdown() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         stop = true;
     }
     condition.notify_all();
+    supervisor_wakeup.notify_all();
+    if (supervisor.joinable()) {
+        supervisor.join();
+    }
+    // With the supervisor gone nothing adds workers; retired ones are joined here too
     for (auto& worker : workers) {
         if (worker.joinable()) {
             worker.join();
@@ -23,21 +51,138 @@ ThreadPool::~ThreadPool() {
     }
 }
 
+PoolStats ThreadPool::get_stats() const {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    PoolStats stats;
+    stats.threads = thread_count.load(std::memory_order_relaxed);
+    stats.idle_threads = idle_threads;
+    stats.queued_tasks = task_queue.size();
+    stats.min_threads = options.min_threads;
+    stats.max_threads = options.max_threads;
+    stats.threads_started = threads_started;
+    stats.threads_retired = threads_retired;
+    return stats;
+}
+
+// Requires queue_mutex
+void ThreadPool::start_worker() {
+    workers.emplace_back([this] { worker_thread(); });
+    thread_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Requires queue_mutex
+std::vector<std::thread> ThreadPool::take_exited() {
+    std::vector<std::thread> finished;
+    for (const auto& id : exited) {
+        auto it = std::find_if(workers.begin(), workers.end(),
+                               [&id](const std::thread& worker) { return worker.get_id() == id; });
+        if (it != workers.end()) {
+            finished.push_back(std::move(*it));
+            workers.erase(it);
+        }
+    }
+    exited.clear();
+    return finished;
+}
+
+void ThreadPool::notify_resize(size_t old_count, size_t new_count) {
+    if (!options.on_resize) {
+        return;
+    }
+    try {
+        options.on_resize(old_count, new_count);
+    } catch (const std::exception& e) {
+        std::cerr << "[ThreadPool] Resize callback threw: " << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "[ThreadPool] Resize callback threw an unknown exception.\n";
+    }
+}
+
+void ThreadPool::supervise() {
+    // Check often enough to react within about one target period
+    const auto tick = std::clamp<std::chrono::milliseconds>(options.target_queue_wait / 2,
+                                                            std::chrono::milliseconds(1),
+                                                            std::chrono::milliseconds(100));
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (!stop) {
+        supervisor_wakeup.wait_for(lock, tick);
+        if (stop) {
+            break;
+        }
+
+        std::vector<std::thread> finished = take_exited();
+
+        // Tasks are queued in FIFO order, so the overdue ones form a prefix.
+        // Each overdue task that no idle worker is about to take gets a new worker.
+        size_t old_count = thread_count.load(std::memory_order_relaxed);
+        size_t added = 0;
+        if (!task_queue.empty() && old_count < options.max_threads) {
+            auto overdue_before = std::chrono::steady_clock::now() - options.target_queue_wait;
+            size_t overdue = 0;
+            for (const auto& task : task_queue) {
+                if (task.enqueued > overdue_before) break;
+                ++overdue;
+            }
+            size_t wanted = overdue > idle_threads ? overdue - idle_threads : 0;
+            added = std::min(wanted, options.max_threads - old_count);
+            for (size_t i = 0; i < added; ++i) {
+                start_worker();
+            }
+            threads_started += added;
+        }
+
+        lock.unlock();
+        for (auto& worker : finished) {
+            worker.join();
+        }
+        if (added > 0) {
+            notify_resize(old_count, old_count + added);
+        }
+        lock.lock();
+    }
+}
+
 void ThreadPool::worker_thread() {
     while (true) {
         std::function<void()> task;
         {
             std::unique_lock<std::mutex> lock(queue_mutex);
-            condition.wait(lock, [this] { return !task_queue.empty() || stop; });
+            ++idle_threads;
+
+            bool retire = false;
+            auto idle_until = std::chrono::steady_clock::now() + options.idle_timeout;
+            while (!stop && task_queue.empty()) {
+                if (!elastic) {
+                    condition.wait(lock);
+                    continue;
+                }
+                if (condition.wait_until(lock, idle_until) == std::cv_status::timeout &&
+                    !stop && task_queue.empty()) {
+                    if (thread_count.load(std::memory_order_relaxed) > options.min_threads) {
+                        retire = true;
+                        break;
+                    }
+                    idle_until = std::chrono::steady_clock::now() + options.idle_timeout;
+                }
+            }
+            --idle_threads;
+
+            if (retire) {
+                size_t old_count = thread_count.fetch_sub(1, std::memory_order_relaxed);
+                ++threads_retired;
+                exited.push_back(std::this_thread::get_id());
+                lock.unlock();
+                notify_resize(old_count, old_count - 1);
+                return;
+            }
 
             if (stop && task_queue.empty()) {
                 break;
             }
 
-            if (!task_queue.empty()) {
-                task = std::move(task_queue.front());
-                task_queue.pop();
-            }
+            task = std::move(task_queue.front().func);
+            task_queue.pop_front();
         }
 
         if (task) {
@@ -0,0 +1,386 @@
+#include "../../include/cppweb/utils/form_parser.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace cppweb::utils {
+
+namespace {
+    std::string to_lower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    std::string trim(const std::string& value) {
+        size_t first = value.find_first_not_of(" \t");
+        if (first == std::string::npos) return "";
+        size_t last = value.find_last_not_of(" \t");
+        return value.substr(first, last - first + 1);
+    }
+
+    // Splits `type; key=value; key="quoted value"` into the type and its parameters
+    std::string parse_header_params(const std::string& value, std::map<std::string, std::string>& params) {
+        size_t semi = value.find(';');
+        std::string type = trim(value.substr(0, semi));
+
+        size_t pos = semi;
+        while (pos != std::string::npos && pos < value.size()) {
+            ++pos; // skip ';'
+            size_t eq = value.find('=', pos);
+            if (eq == std::string::npos) break;
+            std::string key = to_lower(trim(value.substr(pos, eq - pos)));
+
+            size_t start = value.find_first_not_of(" \t", eq + 1);
+            std::string param;
+            if (start != std::string::npos && value[start] == '"') {
+                size_t i = start + 1;
+                for (; i < value.size() && value[i] != '"'; ++i) {
+                    if (value[i] == '\\' && i + 1 < value.size()) ++i;
+                    param += value[i];
+                }
+                pos = value.find(';', i);
+            } else {
+                pos = value.find(';', eq);
+                param = trim(value.substr(eq + 1, pos == std::string::npos ? std::string::npos : pos - eq - 1));
+            }
+            params[key] = param;
+        }
+        return to_lower(type);
+    }
+
+    bool write_all(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+std::string url_decode(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        char c = value[i];
+        if (c == '+') {
+            out += ' ';
+        } else if (c == '%' && i + 2 < value.size() && std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            out += static_cast<char>(std::strtol(value.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+bool FormParser::accepts(const std::string& content_type) {
+    std::map<std::string, std::string> params;
+    std::string type = parse_header_params(content_type, params);
+    return type == "multipart/form-data" || type == "application/x-www-form-urlencoded";
+}
+
+FormParser::FormParser(const std::string& content_type, FormLimits limits)
+    : limits(std::move(limits)), state(State::Preamble) {
+    std::map<std::string, std::string> params;
+    std::string type = parse_header_params(content_type, params);
+
+    if (type == "application/x-www-form-urlencoded") {
+        state = State::UrlEncoded;
+        return;
+    }
+
+    auto boundary = params.find("boundary");
+    if (type != "multipart/form-data" || boundary == params.end() ||
+        boundary->second.empty() || boundary->second.size() > 70) {
+        fail(400, "Missing or invalid multipart boundary");
+        return;
+    }
+
+    delimiter = "\r\n--" + boundary->second;
+    std::fill(std::begin(shift), std::end(shift), delimiter.size());
+    for (size_t i = 0; i + 1 < delimiter.size(); ++i) {
+        shift[static_cast<unsigned char>(delimiter[i])] = delimiter.size() - 1 - i;
+    }
+
+    // The first delimiter may start the body without a preceding CRLF
+    buffer = "\r\n";
+}
+
+FormParser::~FormParser() {
+    close_spill();
+}
+
+bool FormParser::fail(int status, const std::string& message) {
+    close_spill();
+    state = State::Failed;
+    error_code = status;
+    error_message = message;
+    return false;
+}
+
+size_t FormParser::find_delimiter(size_t from) const {
+    // Boyer-Moore-Horspool: compare the last byte first and skip ahead by
+    // the shift of the byte under the end of the window on a mismatch
+    const size_t m = delimiter.size();
+    const unsigned char* haystack = reinterpret_cast<const unsigned char*>(buffer.data());
+    const unsigned char last = static_cast<unsigned char>(delimiter[m - 1]);
+
+    size_t i = from;
+    while (i + m <= buffer.size()) {
+        unsigned char c = haystack[i + m - 1];
+        if (c == last && std::memcmp(haystack + i, delimiter.data(), m - 1) == 0) {
+            return i;
+        }
+        i += shift[c];
+    }
+    return std::string::npos;
+}
+
+void FormParser::compact() {
+    if (offset == buffer.size()) {
+        buffer.clear();
+        offset = 0;
+    } else if (offset > 0 && offset >= buffer.size() / 2) {
+        buffer.erase(0, offset);
+        offset = 0;
+    }
+}
+
+bool FormParser::feed(const char* data, size_t len) {
+    switch (state) {
+        case State::Failed:
+            return false;
+        case State::Epilogue:
+            return true;
+        case State::UrlEncoded: {
+            const char* end = data + len;
+            while (data < end) {
+                const char* amp = static_cast<const char*>(std::memchr(data, '&', static_cast<size_t>(end - data)));
+                pending_field.append(data, amp ? amp : end);
+                if (pending_field.size() > limits.max_field_size) {
+                    return fail(413, "Form field is too large");
+                }
+                if (!amp) break;
+                if (!finish_url_field()) return false;
+                data = amp + 1;
+            }
+            return true;
+        }
+        default:
+            break;
+    }
+
+    buffer.append(data, len);
+
+    while (true) {
+        switch (state) {
+            case State::Preamble:
+            case State::Body: {
+                size_t pos = find_delimiter(offset);
+                size_t end = pos;
+                if (pos == std::string::npos) {
+                    // Hold back a tail that could be the start of a split delimiter
+                    size_t keep = delimiter.size() - 1;
+                    end = buffer.size() > offset + keep ? buffer.size() - keep : offset;
+                }
+                if (state == State::Body && end > offset && !append_to_part(buffer.data() + offset, end - offset)) {
+                    return false;
+                }
+                offset = end;
+                if (pos == std::string::npos) {
+                    compact();
+                    return true;
+                }
+                close_spill();
+                offset += delimiter.size();
+                state = State::AfterDelimiter;
+                break;
+            }
+
+            case State::AfterDelimiter: {
+                if (buffer.size() - offset < 2) {
+                    compact();
+                    return true;
+                }
+                if (buffer.compare(offset, 2, "--") == 0) {
+                    offset = buffer.size();
+                    compact();
+                    state = State::Epilogue;
+                    return true;
+                }
+                if (buffer[offset] == ' ' || buffer[offset] == '\t') {
+                    ++offset; // transport padding after the boundary
+                    break;
+                }
+                if (buffer.compare(offset, 2, "\r\n") != 0) {
+                    return fail(400, "Malformed multipart boundary line");
+                }
+                state = State::Headers; // offset stays on the CRLF so an empty header block ends at once
+                break;
+            }
+
+            case State::Headers: {
+                size_t end = buffer.find("\r\n\r\n", offset);
+                if (end == std::string::npos) {
+                    if (buffer.size() - offset > limits.max_part_headers) {
+                        return fail(413, "Multipart part headers are too large");
+                    }
+                    compact();
+                    return true;
+                }
+                if (end - offset > limits.max_part_headers) {
+                    return fail(413, "Multipart part headers are too large");
+                }
+                std::string block = end > offset ? buffer.substr(offset + 2, end - offset - 2) : std::string();
+                if (!parse_part_headers(block)) {
+                    return false;
+                }
+                offset = end + 4;
+                state = State::Body;
+                break;
+            }
+
+            default:
+                return state != State::Failed;
+        }
+    }
+}
+
+bool FormParser::parse_part_headers(const std::string& block) {
+    if (parts.size() >= limits.max_parts) {
+        return fail(413, "Too many form parts");
+    }
+
+    FormPart part;
+    size_t pos = 0;
+    while (pos < block.size()) {
+        size_t eol = block.find("\r\n", pos);
+        if (eol == std::string::npos) eol = block.size();
+        std::string line = block.substr(pos, eol - pos);
+        pos = eol + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = trim(line.substr(0, colon));
+        std::string value = trim(line.substr(colon + 1));
+        std::string lower_key = to_lower(key);
+
+        if (lower_key == "content-disposition") {
+            std::map<std::string, std::string> params;
+            parse_header_params(value, params);
+            part.name = params["name"];
+            part.filename = params["filename"];
+        } else if (lower_key == "content-type") {
+            part.content_type = value;
+        }
+        part.headers[key] = value;
+    }
+
+    parts.push_back(std::move(part));
+    return true;
+}
+
+bool FormParser::append_to_part(const char* data, size_t len) {
+    FormPart& part = parts.back();
+    size_t new_size = part.size + len;
+
+    if (part.filename.empty()) {
+        if (new_size > limits.max_field_size) {
+            return fail(413, "Form field '" + part.name + "' is too large");
+        }
+    } else if (new_size > limits.max_file_size) {
+        return fail(413, "Uploaded file '" + part.filename + "' is too large");
+    }
+
+    if (spill_fd < 0 && !part.filename.empty() && new_size > limits.spill_threshold && !spill(part)) {
+        return false;
+    }
+
+    if (spill_fd >= 0) {
+        if (!write_all(spill_fd, data, len)) {
+            return fail(500, "Failed to write upload to disk");
+        }
+    } else {
+        part.data.append(data, len);
+    }
+    part.size = new_size;
+    return true;
+}
+
+bool FormParser::spill(FormPart& part) {
+    std::string dir = limits.temp_dir;
+    if (dir.empty()) {
+        const char* env = std::getenv("TMPDIR");
+        dir = env && *env ? env : "/tmp";
+    }
+
+    std::string path = dir + "/cppweb-upload-XXXXXX";
+    int fd = ::mkostemp(&path[0], O_CLOEXEC);
+    if (fd < 0) {
+        return fail(500, "Failed to create temp file for upload");
+    }
+
+    part.file_path = path;
+    part.file_guard = std::shared_ptr<void>(nullptr, [path](void*) { ::unlink(path.c_str()); });
+    spill_fd = fd;
+
+    if (!write_all(fd, part.data.data(), part.data.size())) {
+        return fail(500, "Failed to write upload to disk");
+    }
+    std::string().swap(part.data);
+    return true;
+}
+
+void FormParser::close_spill() {
+    if (spill_fd >= 0) {
+        ::close(spill_fd);
+        spill_fd = -1;
+    }
+}
+
+bool FormParser::finish_url_field() {
+    if (pending_field.empty()) {
+        return true;
+    }
+    if (parts.size() >= limits.max_parts) {
+        return fail(413, "Too many form fields");
+    }
+
+    FormPart part;
+    size_t eq = pending_field.find('=');
+    part.name = url_decode(pending_field.substr(0, eq));
+    if (eq != std::string::npos) {
+        part.data = url_decode(pending_field.substr(eq + 1));
+    }
+    part.size = part.data.size();
+    parts.push_back(std::move(part));
+    pending_field.clear();
+    return true;
+}
+
+bool FormParser::finish() {
+    switch (state) {
+        case State::UrlEncoded:
+            return finish_url_field();
+        case State::Epilogue:
+            return true;
+        case State::Failed:
+            return false;
+        default:
+            return fail(400, "Multipart body ended before the closing boundary");
+    }
+}
+
+} // namespace cppweb::utils
@@ -14,6 +14,7 @@ std::string get_status_message(int code) {
         case 403: return "Forbidden";
         case 404: return "Not Found";
         case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 503: return "Service Unavailable";
@@ -50,6 +51,30 @@ std::string get_mime_type(const std::string& ext) {
     return "application/octet-stream";
 }
 
+void split_request_target(const std::string& target, std::string& path,
+                          std::map<std::string, std::string>& query_params) {
+    size_t query_pos = target.find('?');
+    if (query_pos == std::string::npos) {
+        path = target;
+        return;
+    }
+
+    path = target.substr(0, query_pos);
+    std::string query_string = target.substr(query_pos + 1);
+
+    // Split query string by '&'
+    std::istringstream query_stream(query_string);
+    std::string key_value;
+    while (std::getline(query_stream, key_value, '&')) {
+        size_t eq_pos = key_value.find('=');
+        if (eq_pos != std::string::npos) {
+            query_params[key_value.substr(0, eq_pos)] = key_value.substr(eq_pos + 1);
+        } else if (!key_value.empty()) {
+            query_params[key_value] = "";
+        }
+    }
+}
+
 Request parse_request(const std::string& raw_data) {
     std::istringstream request_stream(raw_data);
     std::string method, raw_path, http_version;
@@ -60,28 +85,14 @@ Request parse_request(const std::string& raw_data) {
     std::getline(request_stream, line);
 
     // Extract query parameters from raw_path
-    std::string path = raw_path;
+    std::string path;
     std::map<std::string, std::string> query_params;
-    size_t query_pos = raw_path.find('?');
-
-    if (query_pos != std::string::npos) {
-        path = raw_path.substr(0, query_pos);
-        std::string query_string = raw_path.substr(query_pos + 1);
-
-        // Split query string by '&'
-        std::istringstream query_stream(query_string);
-        std::string key_value;
-        while (std::getline(query_stream, key_value, '&')) {
-            size_t eq_pos = key_value.find('=');
-            if (eq_pos != std::string::npos) {
-                query_params[key_value.substr(0, eq_pos)] = key_value.substr(eq_pos + 1);
-            } else if (!key_value.empty()) {
-                query_params[key_value] = "";
-            }
-        }
-    }
+    split_request_target(raw_path, path, query_params);
 
-    Request req{method, path, "", {}, query_params};
+    Request req;
+    req.method = method;
+    req.path = path;
+    req.query_params = std::move(query_params);
 
     // Header Parsing
     while (std::getline(request_stream, line) && line != "\r" && !line.empty()) {
@@ -111,4 +122,28 @@ Request parse_request(const std::string& raw_data) {
     return req;
 }
 
+std::string format_response_head(const Response& res, size_t content_length) {
+    std::string head;
+    head.reserve(128 + res.headers.size() * 48);
+    head += "HTTP/1.1 ";
+    head += std::to_string(res.status_code);
+    head += ' ';
+    head += get_status_message(res.status_code);
+    head += "\r\nContent-Type: ";
+    head += res.content_type;
+    head += "\r\nContent-Length: ";
+    head += std::to_string(content_length);
+    head += "\r\nConnection: close\r\n";
+
+    for (const auto& [key, value] : res.headers) {
+        head += key;
+        head += ": ";
+        head += value;
+        head += "\r\n";
+    }
+
+    head += "\r\n";
+    return head;
+}
+
 } // namespace cppweb::utils
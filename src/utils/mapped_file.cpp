@@ -0,0 +1,53 @@
+#include "../../include/cppweb/utils/mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace cppweb::utils {
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw std::runtime_error("Not a regular file: " + path);
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    const char* data = nullptr;
+    if (size > 0) {
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Failed to map " + path + ": " + std::strerror(err));
+        }
+        data = static_cast<const char*>(mapped);
+    }
+
+    // Kept open for transports that read the file rather than the mapping
+    return std::shared_ptr<const MappedFile>(new MappedFile(fd, data, size));
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    ::close(fd_);
+}
+
+BodySegment MappedFile::segment(size_t offset, size_t length) const {
+    offset = std::min(offset, size_);
+    return {shared_from_this(), data_ + offset, std::min(length, size_ - offset), fd_, offset};
+}
+
+} // namespace cppweb::utils
@@ -0,0 +1,147 @@
+#include "../include/cppweb/observability/access_log.hpp"
+#include "test_support.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace cppweb::observability;
+
+namespace {
+
+std::string temp_path() {
+    char path[] = "/tmp/cppweb_access_log_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    return path;
+}
+
+size_t count_lines(const std::string& path) {
+    std::ifstream in(path);
+    return static_cast<size_t>(std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n'));
+}
+
+AccessRecord make_record(int i) {
+    AccessRecord record;
+    record.status_code = 200;
+    record.set(record.method, "GET");
+    record.set(record.path, "/item/" + std::to_string(i));
+    return record;
+}
+
+// A half-full ring must wake the writer even though the flush interval is
+// far away; a producer that leaves it time to drain then never drops
+void test_half_full_ring_wakes_writer() {
+    std::string path = temp_path();
+    const int records = 1000;
+    {
+        AccessLogConfig config;
+        config.path = path;
+        config.ring_capacity = 64;
+        config.flush_interval = std::chrono::seconds(30);
+        AccessLog log(config);
+
+        int refused = 0;
+        for (int i = 0; i < records; ++i) {
+            refused += log.log(make_record(i)) ? 0 : 1;
+            if (i % 8 == 7) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        CHECK_EQ(refused, 0);
+        CHECK_EQ(log.dropped(), 0u);
+    }
+    CHECK_EQ(count_lines(path), static_cast<size_t>(records));
+    ::unlink(path.c_str());
+}
+
+// Records still queued when the log is destroyed are written, not lost
+void test_destructor_drains_rings() {
+    std::string path = temp_path();
+    {
+        AccessLogConfig config;
+        config.path = path;
+        config.flush_interval = std::chrono::seconds(30);
+        AccessLog log(config);
+        for (int i = 0; i < 10; ++i) {
+            log.log(make_record(i));
+        }
+    }
+    CHECK_EQ(count_lines(path), 10u);
+    ::unlink(path.c_str());
+}
+
+// A ring that nobody drains fills up; further records are dropped and counted
+void test_full_ring_counts_drops() {
+    std::string path = temp_path();
+    {
+        AccessLogConfig config;
+        config.path = path;
+        config.ring_capacity = 8;
+        config.flush_interval = std::chrono::seconds(30);
+        AccessLog log(config);
+
+        size_t accepted = 0;
+        for (int i = 0; i < 100000; ++i) {
+            accepted += log.log(make_record(i)) ? 1 : 0;
+        }
+        CHECK_EQ(accepted + log.dropped(), 100000u);
+    }
+    ::unlink(path.c_str());
+}
+
+// Records whose write fails are counted as failed, never as written
+void test_failed_writes_are_not_counted_written() {
+    AccessLogConfig config;
+    config.path = "/dev/full";
+    config.flush_interval = std::chrono::milliseconds(10);
+    AccessLog log(config);
+
+    for (int i = 0; i < 10; ++i) {
+        log.log(make_record(i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (log.failed() < 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK_EQ(log.failed(), 10u);
+    CHECK_EQ(log.written(), 0u);
+}
+
+// A successful batch counts every record in it as written
+void test_written_counts_records() {
+    std::string path = temp_path();
+    AccessLogConfig config;
+    config.path = path;
+    config.flush_interval = std::chrono::milliseconds(10);
+    AccessLog log(config);
+
+    for (int i = 0; i < 10; ++i) {
+        log.log(make_record(i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (log.written() < 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK_EQ(log.written(), 10u);
+    CHECK_EQ(log.failed(), 0u);
+    CHECK_EQ(count_lines(path), 10u);
+    ::unlink(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    test_half_full_ring_wakes_writer();
+    test_destructor_drains_rings();
+    test_full_ring_counts_drops();
+    test_failed_writes_are_not_counted_written();
+    test_written_counts_records();
+    return cppweb::test::test_result();
+}
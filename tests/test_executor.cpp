@@ -0,0 +1,108 @@
+#include "../include/cppweb/threading/executor.hpp"
+#include "test_support.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace cppweb::threading;
+using Admission = Executor::Admission;
+
+namespace {
+
+ExecutorOptions blocking_options(std::chrono::milliseconds timeout) {
+    ExecutorOptions options;
+    options.threads = 1;
+    options.max_queue = 1;
+    options.when_full = QueueFullPolicy::Block;
+    options.block_timeout = timeout;
+    return options;
+}
+
+// Holds the executor's only worker until release() is called
+struct Gate {
+    std::promise<void> opened;
+    std::shared_future<void> wait = opened.get_future().share();
+    void release() { opened.set_value(); }
+};
+
+// A parked task gets the slot a finished task gives up, in order
+void test_parked_task_runs_when_slot_frees() {
+    Executor executor("block", blocking_options(std::chrono::seconds(5)));
+    Gate gate;
+    std::atomic<int> ran{0};
+    std::atomic<int> timed_out{0};
+    auto wait = gate.wait;
+
+    CHECK(executor.submit([wait] { wait.wait(); }) == Admission::Queued);   // running
+    while (executor.stats().queued != 0) std::this_thread::yield();
+    CHECK(executor.submit([&] { ++ran; }) == Admission::Queued);             // queued
+    CHECK(executor.submit([&] { ++ran; }, [&] { ++timed_out; }) == Admission::Queued); // parked
+    CHECK_EQ(executor.stats().waiting, 1u);
+
+    // The submitting thread was not held; now free the worker
+    gate.release();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK_EQ(ran.load(), 2);
+    CHECK_EQ(timed_out.load(), 0);
+    CHECK_EQ(executor.stats().waiting, 0u);
+}
+
+// A parked task that never gets a slot is answered through on_timeout
+void test_parked_task_times_out() {
+    Executor executor("block", blocking_options(std::chrono::milliseconds(50)));
+    Gate gate;
+    std::atomic<int> ran{0};
+    std::promise<std::thread::id> timed_out;
+    auto wait = gate.wait;
+
+    executor.submit([wait] { wait.wait(); });
+    while (executor.stats().queued != 0) std::this_thread::yield();
+    executor.submit([] {});
+
+    auto start = std::chrono::steady_clock::now();
+    CHECK(executor.submit([&] { ++ran; }, [&] { timed_out.set_value(std::this_thread::get_id()); }) ==
+          Admission::Queued);
+    // Parking is limited to max_queue; one more is rejected at once
+    CHECK(executor.submit([&] { ++ran; }, [] {}) == Admission::Rejected);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+
+    std::future<std::thread::id> answered = timed_out.get_future();
+    CHECK(answered.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(answered.get() != std::this_thread::get_id());
+    CHECK_EQ(executor.stats().rejected, 2u);
+
+    gate.release();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_EQ(ran.load(), 0);
+}
+
+// Destroying the executor drops parked tasks without running either function
+void test_destructor_drops_parked() {
+    std::atomic<int> calls{0};
+    Gate gate;
+    auto wait = gate.wait;
+    {
+        Executor executor("block", blocking_options(std::chrono::seconds(30)));
+        executor.submit([wait] { wait.wait(); });
+        while (executor.stats().queued != 0) std::this_thread::yield();
+        executor.submit([] {});
+        executor.submit([&] { ++calls; }, [&] { ++calls; });
+        gate.release();
+        // Racing the worker is fine: the task either ran or was dropped, never both
+    }
+    CHECK(calls.load() <= 1);
+}
+
+} // namespace
+
+int main() {
+    test_parked_task_runs_when_slot_frees();
+    test_parked_task_times_out();
+    test_destructor_drops_parked();
+    return cppweb::test::test_result();
+}
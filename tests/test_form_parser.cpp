@@ -0,0 +1,153 @@
+#include "../include/cppweb/utils/form_parser.hpp"
+#include "test_support.hpp"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace cppweb;
+using cppweb::utils::FormLimits;
+using cppweb::utils::FormParser;
+
+namespace {
+
+const std::string kContentType = "multipart/form-data; boundary=XyZ";
+
+std::string multipart_body(const std::string& file_contents) {
+    return "--XyZ\r\n"
+           "Content-Disposition: form-data; name=\"title\"\r\n"
+           "\r\n"
+           "hello world\r\n"
+           "--XyZ\r\n"
+           "Content-Disposition: form-data; name=\"upload\"; filename=\"a.bin\"\r\n"
+           "Content-Type: application/octet-stream\r\n"
+           "\r\n" +
+           file_contents +
+           "\r\n"
+           "--XyZ--\r\n";
+}
+
+bool parse_in_chunks(FormParser& parser, const std::string& body, size_t chunk) {
+    for (size_t pos = 0; pos < body.size(); pos += chunk) {
+        if (!parser.feed(body.data() + pos, std::min(chunk, body.size() - pos))) {
+            return false;
+        }
+    }
+    return parser.finish();
+}
+
+bool file_exists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// The file holds near misses of the "\r\n--XyZ" delimiter
+const std::string kTrickyFile = "--Xy\r\n--XyY\r\n-\r\n--X";
+
+// Every split of the body, down to one byte per chunk, parses the same
+void test_split_boundaries() {
+    std::string body = multipart_body(kTrickyFile);
+    for (size_t chunk = 1; chunk <= body.size(); ++chunk) {
+        FormParser parser(kContentType);
+        if (!parse_in_chunks(parser, body, chunk)) {
+            cppweb::test::report_failure(__FILE__, __LINE__, "chunk size " + std::to_string(chunk) + ": " + parser.error());
+            continue;
+        }
+        std::vector<FormPart> parts = parser.take_parts();
+        CHECK_EQ(parts.size(), 2u);
+        if (parts.size() != 2) continue;
+        CHECK_EQ(parts[0].name, "title");
+        CHECK_EQ(parts[0].data, "hello world");
+        CHECK_EQ(parts[1].filename, "a.bin");
+        CHECK_EQ(parts[1].content_type, "application/octet-stream");
+        CHECK_EQ(parts[1].data, kTrickyFile);
+    }
+}
+
+void test_urlencoded() {
+    FormParser parser("application/x-www-form-urlencoded");
+    std::string body = "a=1&name=J%C3%B6rg+M&empty=&flag";
+    CHECK(parse_in_chunks(parser, body, 3));
+    std::vector<FormPart> parts = parser.take_parts();
+    CHECK_EQ(parts.size(), 4u);
+    if (parts.size() == 4) {
+        CHECK_EQ(parts[1].name, "name");
+        CHECK_EQ(parts[1].data, "J\xC3\xB6rg M");
+        CHECK_EQ(parts[2].data, "");
+        CHECK_EQ(parts[3].name, "flag");
+    }
+}
+
+void test_limits() {
+    {
+        FormLimits limits;
+        limits.max_field_size = 5;
+        FormParser parser(kContentType, limits);
+        CHECK(!parse_in_chunks(parser, multipart_body("x"), 7));
+        CHECK_EQ(parser.error_status(), 413);
+    }
+    {
+        FormLimits limits;
+        limits.max_parts = 1;
+        FormParser parser(kContentType, limits);
+        CHECK(!parse_in_chunks(parser, multipart_body("x"), 64));
+        CHECK_EQ(parser.error_status(), 413);
+    }
+    {
+        FormLimits limits;
+        limits.max_file_size = 1000;
+        limits.spill_threshold = 100;
+        FormParser parser(kContentType, limits);
+        CHECK(!parse_in_chunks(parser, multipart_body(std::string(5000, 'f')), 512));
+        CHECK_EQ(parser.error_status(), 413);
+    }
+    {
+        FormParser parser(kContentType);
+        std::string body = multipart_body("x");
+        body.resize(body.size() - 4); // closing delimiter cut off
+        CHECK(!parse_in_chunks(parser, body, 64));
+        CHECK_EQ(parser.error_status(), 400);
+    }
+}
+
+// File parts past spill_threshold move to a temp file that goes away with the part
+void test_spill_to_file() {
+    std::string contents;
+    for (int i = 0; i < 20000; ++i) {
+        contents += static_cast<char>(i * 7);
+    }
+
+    FormLimits limits;
+    limits.spill_threshold = 4096;
+    std::string path;
+    {
+        FormParser parser(kContentType, limits);
+        CHECK(parse_in_chunks(parser, multipart_body(contents), 1000));
+        std::vector<FormPart> parts = parser.take_parts();
+        CHECK_EQ(parts.size(), 2u);
+        if (parts.size() != 2) return;
+
+        CHECK(parts[0].in_memory());
+        CHECK(!parts[1].in_memory());
+        CHECK_EQ(parts[1].size, contents.size());
+        path = parts[1].file_path;
+
+        std::ifstream in(path, std::ios::binary);
+        std::string on_disk((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        CHECK(on_disk == contents);
+    }
+    CHECK(!path.empty() && !file_exists(path));
+}
+
+} // namespace
+
+int main() {
+    test_split_boundaries();
+    test_urlencoded();
+    test_limits();
+    test_spill_to_file();
+    return cppweb::test::test_result();
+}
@@ -0,0 +1,189 @@
+#include "../include/cppweb/http2/hpack.hpp"
+#include "test_support.hpp"
+
+#include <cctype>
+#include <string>
+#include <vector>
+
+using namespace cppweb::http2;
+
+namespace {
+
+std::vector<uint8_t> from_hex(const std::string& text) {
+    std::vector<uint8_t> bytes;
+    int high = -1;
+    for (char c : text) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) continue;
+        int nibble = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : std::tolower(c) - 'a' + 10;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            bytes.push_back(static_cast<uint8_t>((high << 4) | nibble));
+            high = -1;
+        }
+    }
+    return bytes;
+}
+
+HeaderList decode_hex(HpackDecoder& decoder, const std::string& text) {
+    std::vector<uint8_t> block = from_hex(text);
+    return decoder.decode(block.data(), block.size());
+}
+
+const HeaderList kRequest1 = {
+    {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+const HeaderList kRequest2 = {
+    {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+    {"cache-control", "no-cache"}};
+const HeaderList kRequest3 = {
+    {":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"}, {":authority", "www.example.com"},
+    {"custom-key", "custom-value"}};
+
+const HeaderList kResponse1 = {
+    {":status", "302"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+    {"location", "https://www.example.com"}};
+const HeaderList kResponse2 = {
+    {":status", "307"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+    {"location", "https://www.example.com"}};
+const HeaderList kResponse3 = {
+    {":status", "200"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+    {"location", "https://www.example.com"}, {"content-encoding", "gzip"},
+    {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}};
+
+// RFC 7541, C.1: integer representation
+void test_integers() {
+    std::string out;
+    hpack::encode_integer(10, 5, 0, out);
+    CHECK(out == std::string("\x0a", 1));
+
+    out.clear();
+    hpack::encode_integer(1337, 5, 0, out);
+    CHECK(out == "\x1f\x9a\x0a");
+
+    out.clear();
+    hpack::encode_integer(42, 8, 0, out);
+    CHECK(out == std::string("\x2a", 1));
+}
+
+// RFC 7541, C.2: single literal fields
+void test_literal_fields() {
+    HpackDecoder decoder;
+    CHECK(decode_hex(decoder, "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572") ==
+          (HeaderList{{"custom-key", "custom-header"}}));
+    CHECK(decode_hex(decoder, "040c 2f73 616d 706c 652f 7061 7468") ==
+          (HeaderList{{":path", "/sample/path"}}));
+    CHECK(decode_hex(decoder, "1008 7061 7373 776f 7264 0673 6563 7265 74") ==
+          (HeaderList{{"password", "secret"}}));
+    CHECK(decode_hex(decoder, "82") == (HeaderList{{":method", "GET"}}));
+}
+
+// RFC 7541, C.3: requests without Huffman coding, sharing one dynamic table
+void test_requests_plain() {
+    HpackDecoder decoder;
+    CHECK(decode_hex(decoder, "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d") == kRequest1);
+    CHECK(decode_hex(decoder, "8286 84be 5808 6e6f 2d63 6163 6865") == kRequest2);
+    CHECK(decode_hex(decoder, "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65") ==
+          kRequest3);
+}
+
+// RFC 7541, C.4: the same requests with Huffman coding
+void test_requests_huffman() {
+    HpackDecoder decoder;
+    CHECK(decode_hex(decoder, "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff") == kRequest1);
+    CHECK(decode_hex(decoder, "8286 84be 5886 a8eb 1064 9cbf") == kRequest2);
+    CHECK(decode_hex(decoder, "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf") == kRequest3);
+
+    CHECK(hpack::huffman_encode("www.example.com") == std::string("\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff"));
+    std::vector<uint8_t> coded = from_hex("a8eb 1064 9cbf");
+    CHECK(hpack::huffman_decode(coded.data(), coded.size()) == "no-cache");
+}
+
+// RFC 7541, C.5: responses without Huffman coding; a 256-byte table forces evictions
+void test_responses_plain() {
+    HpackDecoder decoder(256);
+    CHECK(decode_hex(decoder,
+                     "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133"
+                     "2032 303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70"
+                     "6c65 2e63 6f6d") == kResponse1);
+    CHECK(decode_hex(decoder, "4803 3330 37c1 c0bf") == kResponse2);
+    CHECK(decode_hex(decoder,
+                     "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220 474d"
+                     "54c0 5a04 677a 6970 7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049"
+                     "5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b 2076 6572 7369 6f6e"
+                     "3d31") == kResponse3);
+}
+
+// RFC 7541, C.6: the same responses with Huffman coding
+void test_responses_huffman() {
+    HpackDecoder decoder(256);
+    CHECK(decode_hex(decoder,
+                     "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6"
+                     "2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3") == kResponse1);
+    CHECK(decode_hex(decoder, "4883 640e ffc1 c0bf") == kResponse2);
+    CHECK(decode_hex(decoder,
+                     "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b d9ab"
+                     "77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f"
+                     "9587 3160 65c0 03ed 4ee5 b106 3d50 07") == kResponse3);
+}
+
+void test_encoder_round_trip() {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    HeaderList headers = {{":status", "200"}, {"content-type", "text/plain"}, {"x-custom", "value"}};
+    for (int i = 0; i < 3; ++i) {
+        std::string block;
+        encoder.encode(headers, block);
+        CHECK(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size()) == headers);
+    }
+}
+
+void test_malformed_input() {
+    HpackDecoder decoder;
+    // Index 70 is past the static table with an empty dynamic table
+    CHECK_THROWS(decode_hex(decoder, "c6"), HpackError);
+    // String length runs past the end of the block
+    CHECK_THROWS(decode_hex(decoder, "400a 6375"), HpackError);
+    // Table size update above the advertised SETTINGS_HEADER_TABLE_SIZE
+    CHECK_THROWS(decode_hex(decoder, "3fe2 1f"), HpackError);
+}
+
+// A small block of indexed references must not expand past the list limit
+void test_header_list_limit() {
+    std::string block;
+    hpack::encode_integer(0, 6, 0x40, block);
+    hpack::encode_integer(1, 7, 0, block);
+    block += 'x';
+    hpack::encode_integer(4000, 7, 0, block);
+    block.append(4000, 'v');
+    for (int i = 0; i < 1000; ++i) {
+        hpack::encode_integer(62, 7, 0x80, block);
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(block.data());
+
+    HpackDecoder limited(4096, 64 * 1024);
+    CHECK(block.size() < 64 * 1024);
+    CHECK_THROWS(limited.decode(data, block.size()), HpackListTooLarge);
+
+    // Exactly at the limit is accepted: name + value + 32 per field
+    HpackDecoder exact(4096, 2 * (1 + 4000 + 32));
+    HeaderList fields = exact.decode(data, block.size() - 999);
+    CHECK_EQ(fields.size(), 2u);
+
+    HpackDecoder unlimited;
+    CHECK_EQ(unlimited.decode(data, block.size()).size(), 1001u);
+}
+
+} // namespace
+
+int main() {
+    test_integers();
+    test_literal_fields();
+    test_requests_plain();
+    test_requests_huffman();
+    test_responses_plain();
+    test_responses_huffman();
+    test_encoder_round_trip();
+    test_malformed_input();
+    test_header_list_limit();
+    return cppweb::test::test_result();
+}
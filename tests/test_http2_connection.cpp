@@ -0,0 +1,530 @@
+#include "../include/cppweb/http2/connection.hpp"
+#include "../include/cppweb/http2/hpack.hpp"
+#include "../include/cppweb/net/transport.hpp"
+#include "test_support.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cppweb;
+using namespace cppweb::http2;
+
+namespace {
+
+enum : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9
+};
+
+constexpr uint8_t END_STREAM = 0x1;
+constexpr uint8_t ACK = 0x1;
+constexpr uint8_t END_HEADERS = 0x4;
+
+constexpr uint32_t PROTOCOL_ERROR = 0x1;
+constexpr uint32_t FRAME_SIZE_ERROR = 0x6;
+constexpr uint32_t REFUSED_STREAM = 0x7;
+constexpr uint32_t CANCEL = 0x8;
+
+constexpr uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+
+struct Frame {
+    uint8_t type = 0;
+    uint8_t flags = 0;
+    uint32_t stream_id = 0;
+    std::string payload;
+};
+
+std::string u32(uint32_t value) {
+    std::string out;
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>(value >> 16);
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+    return out;
+}
+
+uint32_t read_u32(const std::string& data, size_t pos) {
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data() + pos);
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+std::string frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+    std::string out;
+    out += static_cast<char>(payload.size() >> 16);
+    out += static_cast<char>(payload.size() >> 8);
+    out += static_cast<char>(payload.size());
+    out += static_cast<char>(type);
+    out += static_cast<char>(flags);
+    out += u32(stream_id);
+    return out + payload;
+}
+
+std::string setting(uint16_t id, uint32_t value) {
+    std::string out;
+    out += static_cast<char>(id >> 8);
+    out += static_cast<char>(id);
+    return out + u32(value);
+}
+
+// The client end of a socketpair whose other end the Connection serves
+class Peer {
+public:
+    Peer() {
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0) {
+            transport = std::make_unique<net::PlainTransport>(fds[0]);
+        }
+    }
+
+    ~Peer() {
+        transport.reset();
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    net::Transport& server() { return *transport; }
+
+    void send(const std::string& bytes) {
+        size_t sent = 0;
+        while (sent < bytes.size()) {
+            ssize_t n = ::write(fds[1], bytes.data() + sent, bytes.size() - sent);
+            if (n <= 0) return;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void send_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload) {
+        send(frame(type, flags, stream_id, payload));
+    }
+
+    std::string request_block(const std::string& method, const std::string& path, const HeaderList& extra = {}) {
+        HeaderList fields = {{":method", method}, {":scheme", "http"}, {":path", path}, {":authority", "test"}};
+        fields.insert(fields.end(), extra.begin(), extra.end());
+        std::string block;
+        encoder.encode(fields, block);
+        return block;
+    }
+
+    // Everything the server has written so far, as complete frames
+    std::vector<Frame> receive() {
+        char chunk[65536];
+        pollfd pfd{fds[1], POLLIN, 0};
+        while (::poll(&pfd, 1, 0) > 0) {
+            ssize_t n = ::recv(fds[1], chunk, sizeof(chunk), MSG_DONTWAIT);
+            if (n <= 0) break;
+            pending.append(chunk, static_cast<size_t>(n));
+        }
+
+        std::vector<Frame> frames;
+        while (pending.size() >= 9) {
+            size_t length = (size_t(uint8_t(pending[0])) << 16) | (size_t(uint8_t(pending[1])) << 8) | uint8_t(pending[2]);
+            if (pending.size() < 9 + length) break;
+            Frame f;
+            f.type = static_cast<uint8_t>(pending[3]);
+            f.flags = static_cast<uint8_t>(pending[4]);
+            f.stream_id = read_u32(pending, 5) & 0x7fffffff;
+            f.payload = pending.substr(9, length);
+            frames.push_back(std::move(f));
+            pending.erase(0, 9 + length);
+        }
+        return frames;
+    }
+
+    HeaderList decode(const std::string& block) {
+        return decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size());
+    }
+
+private:
+    int fds[2] = {-1, -1};
+    std::unique_ptr<net::PlainTransport> transport;
+    HpackEncoder encoder;
+    HpackDecoder decoder{4096, 64 * 1024};
+    std::string pending;
+};
+
+std::optional<Frame> find_frame(const std::vector<Frame>& frames, uint8_t type, uint32_t stream_id) {
+    for (const auto& f : frames) {
+        if (f.type == type && f.stream_id == stream_id) return f;
+    }
+    return std::nullopt;
+}
+
+std::string data_for(const std::vector<Frame>& frames, uint32_t stream_id, bool* ended = nullptr) {
+    std::string body;
+    for (const auto& f : frames) {
+        if (f.type == DATA && f.stream_id == stream_id) {
+            body += f.payload;
+            if (ended && (f.flags & END_STREAM)) *ended = true;
+        }
+    }
+    return body;
+}
+
+std::string header(const HeaderList& fields, const std::string& name) {
+    for (const auto& [key, value] : fields) {
+        if (key == name) return value;
+    }
+    return "";
+}
+
+ConnectionCallbacks echo_path(std::string body_prefix = "path=") {
+    ConnectionCallbacks callbacks;
+    callbacks.dispatch = [body_prefix](Request& req, Response& res) {
+        res.body = body_prefix + req.path;
+        auto it = req.headers.find("X-Long");
+        if (it != req.headers.end()) {
+            res.headers["X-Long-Size"] = std::to_string(it->second.size());
+        }
+        return true;
+    };
+    return callbacks;
+}
+
+// Server SETTINGS on start, ACK for ours, then one request answered
+void test_settings_and_simple_request() {
+    Peer peer;
+    Connection conn(peer.server(), echo_path());
+    CHECK(conn.start(kClientPreface + frame(SETTINGS, 0, 0, "")));
+
+    std::vector<Frame> frames = peer.receive();
+    CHECK(!frames.empty() && frames[0].type == SETTINGS && frames[0].flags == 0);
+
+    CHECK(conn.service());
+    frames = peer.receive();
+    std::optional<Frame> ack = find_frame(frames, SETTINGS, 0);
+    CHECK(ack && ack->flags == ACK);
+
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 1, peer.request_block("GET", "/hello"));
+    CHECK(conn.service());
+    frames = peer.receive();
+    std::optional<Frame> headers = find_frame(frames, HEADERS, 1);
+    CHECK(headers.has_value());
+    if (headers) {
+        HeaderList fields = peer.decode(headers->payload);
+        CHECK_EQ(header(fields, ":status"), "200");
+        CHECK_EQ(header(fields, "content-length"), "11");
+    }
+    bool ended = false;
+    CHECK_EQ(data_for(frames, 1, &ended), "path=/hello");
+    CHECK(ended);
+}
+
+// Frames split across reads are put back together; PING is echoed
+void test_partial_frame_and_ping() {
+    Peer peer;
+    Connection conn(peer.server(), echo_path());
+    CHECK(conn.start(kClientPreface));
+    CHECK(conn.service());
+    peer.receive();
+
+    std::string ping = frame(PING, 0, 0, "12345678");
+    peer.send(ping.substr(0, 5));
+    CHECK(conn.service());
+    CHECK(!find_frame(peer.receive(), PING, 0));
+
+    peer.send(ping.substr(5));
+    CHECK(conn.service());
+    std::vector<Frame> frames = peer.receive();
+    std::optional<Frame> pong = find_frame(frames, PING, 0);
+    CHECK(pong && pong->flags == ACK && pong->payload == "12345678");
+}
+
+// A frame longer than our SETTINGS_MAX_FRAME_SIZE ends the connection
+void test_oversized_frame_is_frame_size_error() {
+    Peer peer;
+    Connection conn(peer.server(), echo_path());
+    CHECK(conn.start(kClientPreface));
+    CHECK(conn.service());
+    peer.receive();
+
+    peer.send_frame(PING, 0, 0, std::string(16385, 'x'));
+    CHECK(!conn.service());
+    std::optional<Frame> goaway = find_frame(peer.receive(), GOAWAY, 0);
+    CHECK(goaway && read_u32(goaway->payload, 4) == FRAME_SIZE_ERROR);
+}
+
+// DATA stops at the stream window; WINDOW_UPDATE and a larger
+// SETTINGS_INITIAL_WINDOW_SIZE each let more through
+void test_stream_flow_control() {
+    Peer peer;
+    ConnectionCallbacks callbacks;
+    callbacks.dispatch = [](Request&, Response& res) {
+        res.body = std::string(25, 'a');
+        return true;
+    };
+    Connection conn(peer.server(), std::move(callbacks));
+    CHECK(conn.start(kClientPreface + frame(SETTINGS, 0, 0, setting(SETTINGS_INITIAL_WINDOW_SIZE, 10))));
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 1, peer.request_block("GET", "/"));
+    CHECK(conn.service());
+
+    bool ended = false;
+    CHECK_EQ(data_for(peer.receive(), 1, &ended).size(), 10u);
+    CHECK(!ended);
+
+    peer.send_frame(WINDOW_UPDATE, 0, 1, u32(10));
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 1, &ended).size(), 10u);
+    CHECK(!ended);
+
+    // 10 -> 20 adds 10 to the open stream's window; 5 bytes are left
+    peer.send_frame(SETTINGS, 0, 0, setting(SETTINGS_INITIAL_WINDOW_SIZE, 20));
+    CHECK(conn.service());
+    std::vector<Frame> frames = peer.receive();
+    CHECK_EQ(data_for(frames, 1, &ended).size(), 5u);
+    CHECK(ended);
+    std::optional<Frame> ack = find_frame(frames, SETTINGS, 0);
+    CHECK(ack && ack->flags == ACK);
+}
+
+// The connection window caps all streams together until the client tops it up
+void test_connection_flow_control() {
+    Peer peer;
+    ConnectionCallbacks callbacks;
+    callbacks.dispatch = [](Request&, Response& res) {
+        res.body = std::string(70000, 'b');
+        return true;
+    };
+    Connection conn(peer.server(), std::move(callbacks));
+    CHECK(conn.start(kClientPreface + frame(SETTINGS, 0, 0, setting(SETTINGS_INITIAL_WINDOW_SIZE, 1 << 20))));
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 1, peer.request_block("GET", "/"));
+    CHECK(conn.service());
+
+    bool ended = false;
+    CHECK_EQ(data_for(peer.receive(), 1, &ended).size(), 65535u);
+    CHECK(!ended);
+
+    peer.send_frame(WINDOW_UPDATE, 0, 0, u32(10000));
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 1, &ended).size(), 70000u - 65535u);
+    CHECK(ended);
+
+    // Past 2^31 - 1 is a connection error
+    peer.send_frame(WINDOW_UPDATE, 0, 0, u32(0x7fffffff));
+    CHECK(!conn.service());
+    CHECK(find_frame(peer.receive(), GOAWAY, 0));
+}
+
+// A header block split over HEADERS and CONTINUATION is decoded as one
+void test_continuation_assembly() {
+    Peer peer;
+    Connection conn(peer.server(), echo_path());
+    CHECK(conn.start(kClientPreface));
+    CHECK(conn.service());
+    peer.receive();
+
+    std::string block = peer.request_block("GET", "/joined", {{"x-long", std::string(3000, 'v')}});
+    size_t third = block.size() / 3;
+    peer.send_frame(HEADERS, END_STREAM, 1, block.substr(0, third));
+    peer.send_frame(CONTINUATION, 0, 1, block.substr(third, third));
+    CHECK(conn.service());
+    CHECK(!find_frame(peer.receive(), HEADERS, 1));
+
+    peer.send_frame(CONTINUATION, END_HEADERS, 1, block.substr(2 * third));
+    CHECK(conn.service());
+    std::vector<Frame> frames = peer.receive();
+    std::optional<Frame> headers = find_frame(frames, HEADERS, 1);
+    CHECK(headers.has_value());
+    if (headers) {
+        CHECK_EQ(header(peer.decode(headers->payload), "x-long-size"), "3000");
+    }
+    CHECK_EQ(data_for(frames, 1), "path=/joined");
+}
+
+// Nothing may come between HEADERS and its last CONTINUATION
+void test_interleaved_continuation_is_protocol_error() {
+    {
+        Peer peer;
+        Connection conn(peer.server(), echo_path());
+        CHECK(conn.start(kClientPreface));
+        CHECK(conn.service());
+        peer.receive();
+
+        std::string block = peer.request_block("GET", "/");
+        peer.send_frame(HEADERS, END_STREAM, 1, block.substr(0, 2));
+        peer.send_frame(PING, 0, 0, "12345678");
+        CHECK(!conn.service());
+        std::optional<Frame> goaway = find_frame(peer.receive(), GOAWAY, 0);
+        CHECK(goaway && read_u32(goaway->payload, 4) == PROTOCOL_ERROR);
+    }
+    {
+        // CONTINUATION for another stream
+        Peer peer;
+        Connection conn(peer.server(), echo_path());
+        CHECK(conn.start(kClientPreface));
+        CHECK(conn.service());
+        peer.receive();
+
+        std::string block = peer.request_block("GET", "/");
+        peer.send_frame(HEADERS, END_STREAM, 1, block.substr(0, 2));
+        peer.send_frame(CONTINUATION, END_HEADERS, 3, block.substr(2));
+        CHECK(!conn.service());
+        CHECK(find_frame(peer.receive(), GOAWAY, 0));
+    }
+    {
+        // CONTINUATION with no header block open
+        Peer peer;
+        Connection conn(peer.server(), echo_path());
+        CHECK(conn.start(kClientPreface));
+        CHECK(conn.service());
+        peer.receive();
+
+        peer.send_frame(CONTINUATION, END_HEADERS, 1, peer.request_block("GET", "/"));
+        CHECK(!conn.service());
+        CHECK(find_frame(peer.receive(), GOAWAY, 0));
+    }
+}
+
+// A stream beyond max_concurrent_streams is refused, the others carry on
+void test_refused_stream_past_limit() {
+    Peer peer;
+    ConnectionSettings settings;
+    settings.max_concurrent_streams = 1;
+    Connection conn(peer.server(), echo_path(), settings);
+    CHECK(conn.start(kClientPreface));
+    CHECK(conn.service());
+    peer.receive();
+
+    // Stream 1 stays open waiting for its body
+    peer.send_frame(HEADERS, END_HEADERS, 1, peer.request_block("POST", "/first"));
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 3, peer.request_block("GET", "/second"));
+    CHECK(conn.service());
+    std::vector<Frame> frames = peer.receive();
+    std::optional<Frame> reset = find_frame(frames, RST_STREAM, 3);
+    CHECK(reset && read_u32(reset->payload, 0) == REFUSED_STREAM);
+    CHECK(!find_frame(frames, HEADERS, 3));
+
+    peer.send_frame(DATA, END_STREAM, 1, "body");
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 1), "path=/first");
+
+    // Once stream 1 is done there is room again
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 5, peer.request_block("GET", "/third"));
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 5), "path=/third");
+}
+
+// A stream reset while its handler runs elsewhere is dropped when the
+// handler reports back; the connection keeps serving others
+void test_reset_while_handler_runs() {
+    Peer peer;
+    std::atomic<bool> release{false};
+    std::atomic<bool> woken{false};
+    std::atomic<int> handled{0};
+    std::vector<std::thread> workers;
+
+    ConnectionCallbacks callbacks = echo_path();
+    auto dispatch = callbacks.dispatch;
+    callbacks.dispatch = [&handled, dispatch](Request& req, Response& res) {
+        ++handled;
+        return dispatch(req, res);
+    };
+    callbacks.submit = [&](const Request&, std::function<void()> task, std::function<void()>) {
+        workers.emplace_back([&release, task] {
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            task();
+        });
+        return true;
+    };
+    callbacks.wake = [&woken] { woken = true; };
+
+    Connection conn(peer.server(), std::move(callbacks));
+    CHECK(conn.start(kClientPreface));
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 1, peer.request_block("GET", "/slow"));
+    CHECK(conn.service());
+    CHECK(conn.handlers_running());
+
+    peer.send_frame(RST_STREAM, 0, 1, u32(CANCEL));
+    CHECK(conn.service());
+    CHECK(conn.handlers_running());
+
+    release = true;
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+    CHECK(woken.load());
+    CHECK_EQ(handled.load(), 1);
+
+    CHECK(conn.service());
+    CHECK(!conn.handlers_running());
+    std::vector<Frame> frames = peer.receive();
+    CHECK(!find_frame(frames, HEADERS, 1));
+    CHECK(!find_frame(frames, DATA, 1));
+
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 3, peer.request_block("GET", "/next"));
+    CHECK(conn.service());
+    for (auto& worker : workers) worker.join();
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 3), "path=/next");
+}
+
+// The request that carried an h2c upgrade becomes stream 1, with the
+// client's HTTP2-Settings applied before its response is sent
+void test_h2c_upgrade_adoption() {
+    Request req;
+    req.method = "GET";
+    req.path = "/upgraded";
+    req.headers["Connection"] = "Upgrade, HTTP2-Settings";
+    req.headers["Upgrade"] = "h2c";
+    req.headers["HTTP2-Settings"] = "AAQAAAAF"; // SETTINGS_INITIAL_WINDOW_SIZE = 5
+    CHECK(is_h2c_upgrade(req));
+
+    Peer peer;
+    uint64_t bytes_in = 0;
+    ConnectionCallbacks callbacks = echo_path();
+    callbacks.completed = [&bytes_in](const Request&, const Response&, const StreamStats& stats) {
+        bytes_in = stats.bytes_in;
+    };
+    Connection conn(peer.server(), std::move(callbacks));
+    conn.adopt_upgrade(req, 120);
+    CHECK(conn.start(kClientPreface));
+    CHECK(conn.service());
+
+    std::vector<Frame> frames = peer.receive();
+    std::optional<Frame> headers = find_frame(frames, HEADERS, 1);
+    CHECK(headers.has_value());
+    if (headers) {
+        CHECK_EQ(header(peer.decode(headers->payload), ":status"), "200");
+    }
+    bool ended = false;
+    CHECK_EQ(data_for(frames, 1, &ended), "path=");
+    CHECK(!ended);
+
+    peer.send_frame(WINDOW_UPDATE, 0, 1, u32(100));
+    CHECK(conn.service());
+    CHECK_EQ(data_for(peer.receive(), 1, &ended), "/upgraded");
+    CHECK(ended);
+    CHECK_EQ(bytes_in, 120u);
+
+    // Client streams continue after the adopted one
+    peer.send_frame(HEADERS, END_HEADERS | END_STREAM, 3, peer.request_block("GET", "/after"));
+    CHECK(conn.service());
+    frames = peer.receive();
+    CHECK(find_frame(frames, HEADERS, 3));
+}
+
+} // namespace
+
+int main() {
+    test_settings_and_simple_request();
+    test_partial_frame_and_ping();
+    test_oversized_frame_is_frame_size_error();
+    test_stream_flow_control();
+    test_connection_flow_control();
+    test_continuation_assembly();
+    test_interleaved_continuation_is_protocol_error();
+    test_refused_stream_past_limit();
+    test_reset_while_handler_runs();
+    test_h2c_upgrade_adoption();
+    return cppweb::test::test_result();
+}
@@ -0,0 +1,182 @@
+#include "../include/cppweb/observability/metrics.hpp"
+#include "test_support.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cppweb::observability;
+
+namespace {
+
+RequestSample sample(const std::string& method, const std::string& route, const uint64_t* queue_wait_ns = nullptr,
+                     bool closed = false) {
+    return {method, route, 200, 1000, 5000, 10, 20, queue_wait_ns, closed};
+}
+
+void test_method_labels() {
+    CHECK(classify_method("GET") == HttpMethod::Get);
+    CHECK(classify_method("OPTIONS") == HttpMethod::Options);
+    CHECK(classify_method("get") == HttpMethod::Other);
+    CHECK(classify_method("PROPFIND") == HttpMethod::Other);
+    CHECK_EQ(std::string(method_label(HttpMethod::Delete)), "DELETE");
+    CHECK_EQ(std::string(method_label(HttpMethod::Other)), "OTHER");
+}
+
+// Methods invented by clients share one label instead of adding series
+void test_unknown_methods_fold_into_other() {
+    MetricsRegistry registry;
+    const std::string route = "/";
+    for (int i = 0; i < 100; ++i) {
+        registry.record_request(sample("X" + std::to_string(i), route));
+    }
+    registry.record_request(sample("POST", route));
+
+    MetricsSnapshot snap = registry.snapshot();
+    CHECK_EQ(snap.routes.size(), 2u);
+    CHECK_EQ(snap.routes["OTHER"]["/"].requests, 100u);
+    CHECK_EQ(snap.routes["POST"]["/"].requests, 1u);
+    CHECK(registry.render_prometheus().find("method=\"X1\"") == std::string::npos);
+}
+
+// Queue wait and close recorded with the request count like the separate calls
+void test_connection_folded_into_request() {
+    MetricsRegistry registry;
+    const std::string route = "/";
+    uint64_t queue_wait_ns = 3000;
+
+    registry.connection_opened();
+    registry.connection_opened();
+    registry.connection_opened();
+    CHECK_EQ(registry.snapshot().active_connections(), 3u);
+
+    // One connection ends with its request, one without any, one stays open
+    std::thread([&] { registry.record_request(sample("GET", route, &queue_wait_ns, true)); }).join();
+    registry.connection_closed(&queue_wait_ns);
+
+    MetricsSnapshot snap = registry.snapshot();
+    CHECK_EQ(snap.connections_opened, 3u);
+    CHECK_EQ(snap.connections_closed, 2u);
+    CHECK_EQ(snap.active_connections(), 1u);
+    CHECK_EQ(snap.queue_wait.count(), 2u);
+    CHECK_EQ(snap.routes["GET"]["/"].requests, 1u);
+}
+
+// Values below 16 get a bucket each; above that every power of two is split in 16
+void test_histogram_bucket_edges() {
+    CHECK_EQ(LatencyHistogram::bucket_index(15), 15u);
+    CHECK_EQ(LatencyHistogram::bucket_index(16), 16u);
+    CHECK_EQ(LatencyHistogram::bucket_index(31), 31u);
+    CHECK_EQ(LatencyHistogram::bucket_index(32), 32u);
+    CHECK_EQ(LatencyHistogram::bucket_index(33), 32u);
+    CHECK_EQ(LatencyHistogram::bucket_index(34), 33u);
+
+    CHECK_EQ(LatencyHistogram::bucket_lower_bound(15), 15u);
+    CHECK_EQ(LatencyHistogram::bucket_upper_bound(15), 15u);
+    CHECK_EQ(LatencyHistogram::bucket_lower_bound(16), 16u);
+    CHECK_EQ(LatencyHistogram::bucket_upper_bound(16), 16u);
+    CHECK_EQ(LatencyHistogram::bucket_lower_bound(31), 31u);
+    CHECK_EQ(LatencyHistogram::bucket_upper_bound(31), 31u);
+    CHECK_EQ(LatencyHistogram::bucket_lower_bound(32), 32u);
+    CHECK_EQ(LatencyHistogram::bucket_upper_bound(32), 33u);
+
+    // Every value lies within the bounds of its bucket, and buckets are contiguous
+    for (uint64_t value = 0; value < 4096; ++value) {
+        size_t index = LatencyHistogram::bucket_index(value);
+        CHECK(LatencyHistogram::bucket_lower_bound(index) <= value);
+        CHECK(value <= LatencyHistogram::bucket_upper_bound(index));
+    }
+    for (size_t index = 1; index < LatencyHistogram::kBucketCount; ++index) {
+        CHECK_EQ(LatencyHistogram::bucket_lower_bound(index), LatencyHistogram::bucket_upper_bound(index - 1) + 1);
+    }
+}
+
+// Durations past ~68s all land in the top bucket instead of indexing past the array
+void test_histogram_clamps_to_top_bucket() {
+    const uint64_t max_value = (uint64_t(1) << LatencyHistogram::kMaxValueBits) - 1;
+    const size_t top = LatencyHistogram::kBucketCount - 1;
+
+    CHECK_EQ(LatencyHistogram::bucket_index(max_value), top);
+    CHECK_EQ(LatencyHistogram::bucket_index(max_value + 1), top);
+    CHECK_EQ(LatencyHistogram::bucket_index(UINT64_MAX), top);
+    CHECK_EQ(LatencyHistogram::bucket_upper_bound(top), max_value);
+
+    LatencyHistogram hist;
+    hist.record(uint64_t(1) << 40);
+    hist.record(UINT64_MAX);
+    CHECK_EQ(hist.count(), 2u);
+    CHECK_EQ(hist.percentile(100), max_value);
+    CHECK_EQ(hist.count_at_or_below(max_value), 2u);
+    CHECK_EQ(hist.count_at_or_below(max_value - 1), 0u);
+}
+
+// Bucket lines of the one series in a rendering, in order, as (le, count)
+std::vector<std::pair<std::string, uint64_t>> rendered_buckets(const std::string& text, const std::string& name) {
+    std::vector<std::pair<std::string, uint64_t>> buckets;
+    std::istringstream in(text);
+    std::string line;
+    const std::string prefix = name + "_bucket{";
+    while (std::getline(in, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        size_t le = line.find("le=\"") + 4;
+        size_t close = line.find('"', le);
+        size_t space = line.rfind(' ');
+        buckets.emplace_back(line.substr(le, close - le), std::stoull(line.substr(space + 1)));
+    }
+    return buckets;
+}
+
+uint64_t rendered_count(const std::string& text, const std::string& name) {
+    std::istringstream in(text);
+    std::string line;
+    const std::string prefix = name + "_count{";
+    while (std::getline(in, line)) {
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            return std::stoull(line.substr(line.rfind(' ') + 1));
+        }
+    }
+    return 0;
+}
+
+// Prometheus buckets are cumulative and the last one, +Inf, holds every sample
+void test_prometheus_buckets_cumulative() {
+    MetricsRegistry registry;
+    const std::string method = "GET";
+    const std::string route = "/";
+    for (uint64_t total_ns : {50000ull, 2000000ull, 2000000ull, 300000000ull, 20000000000ull, 100000000000ull}) {
+        registry.record_request({method, route, 200, total_ns / 2, total_ns, 0, 0, nullptr, false});
+    }
+
+    const std::string text = registry.render_prometheus();
+    const std::string name = "cppweb_http_request_duration_seconds";
+    auto buckets = rendered_buckets(text, name);
+    CHECK_EQ(buckets.size(), 17u);
+    if (buckets.empty()) {
+        return;
+    }
+    for (size_t i = 1; i < buckets.size(); ++i) {
+        CHECK(buckets[i - 1].second <= buckets[i].second);
+    }
+    CHECK_EQ(buckets.front().second, 1u);
+    CHECK_EQ(buckets[buckets.size() - 2].first, std::string("10"));
+    CHECK_EQ(buckets[buckets.size() - 2].second, 4u);
+    CHECK_EQ(buckets.back().first, std::string("+Inf"));
+    CHECK_EQ(buckets.back().second, 6u);
+    CHECK_EQ(buckets.back().second, rendered_count(text, name));
+}
+
+} // namespace
+
+int main() {
+    test_method_labels();
+    test_unknown_methods_fold_into_other();
+    test_connection_folded_into_request();
+    test_histogram_bucket_edges();
+    test_histogram_clamps_to_top_bucket();
+    test_prometheus_buckets_cumulative();
+    return cppweb::test::test_result();
+}
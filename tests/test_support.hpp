@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Minimal assertion helpers shared by the test executables. A failed check
+// is reported and counted; main() returns test_result() so ctest sees it.
+
+namespace cppweb::test {
+
+inline int& failure_count() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void report_failure(const char* file, int line, const std::string& what) {
+    std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+    ++failure_count();
+}
+
+inline int test_result() {
+    if (failure_count() != 0) {
+        std::cerr << failure_count() << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace cppweb::test
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) cppweb::test::report_failure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        if (!((actual) == (expected))) cppweb::test::report_failure(__FILE__, __LINE__, #actual " == " #expected); \
+    } while (0)
+
+#define CHECK_THROWS(statement, exception_type) \
+    do { \
+        bool caught_ = false; \
+        try { statement; } catch (const exception_type&) { caught_ = true; } catch (...) {} \
+        if (!caught_) cppweb::test::report_failure(__FILE__, __LINE__, #statement " throws " #exception_type); \
+    } while (0)
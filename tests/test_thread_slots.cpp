@@ -0,0 +1,153 @@
+#include "../include/cppweb/observability/access_log.hpp"
+#include "../include/cppweb/observability/metrics.hpp"
+#include "../include/cppweb/observability/thread_slots.hpp"
+#include "../include/cppweb/observability/tracer.hpp"
+#include "../include/cppweb/threading/thread_pool.hpp"
+#include "test_support.hpp"
+
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace cppweb::observability;
+using cppweb::threading::PoolOptions;
+using cppweb::threading::ThreadPool;
+
+namespace {
+
+struct Counter {
+    uint64_t value = 0;
+};
+
+std::unique_ptr<Counter> make_counter(size_t) {
+    return std::make_unique<Counter>();
+}
+
+// A thread that exits gives its slot, and what it holds, to the next one
+void test_exited_thread_slot_is_reused() {
+    ThreadSlots<Counter> slots;
+    for (int i = 0; i < 10; ++i) {
+        std::thread([&slots] { ++slots.local(make_counter).value; }).join();
+    }
+    CHECK_EQ(slots.size(), 1u);
+
+    uint64_t total = 0;
+    slots.for_each([&total](const Counter& counter) { total += counter.value; });
+    CHECK_EQ(total, 10u);
+}
+
+// Threads alive at the same time never share a slot
+void test_concurrent_threads_get_own_slots() {
+    ThreadSlots<Counter> slots;
+    Counter* first = nullptr;
+    Counter* second = nullptr;
+    std::atomic<int> ready{0};
+
+    std::thread a([&] { first = &slots.local(make_counter); ready++; while (ready < 2) std::this_thread::yield(); });
+    std::thread b([&] { second = &slots.local(make_counter); ready++; while (ready < 2) std::this_thread::yield(); });
+    a.join();
+    b.join();
+
+    CHECK(first != second);
+    CHECK_EQ(slots.size(), 2u);
+}
+
+// A thread may outlive the owner whose slot it holds
+void test_thread_outlives_owner() {
+    std::atomic<bool> released{false};
+    std::atomic<bool> done{false};
+    auto slots = std::make_unique<ThreadSlots<Counter>>();
+
+    std::thread worker([&] {
+        slots->local(make_counter).value = 1;
+        done = true;
+        while (!released) std::this_thread::yield();
+    });
+    while (!done) std::this_thread::yield();
+    slots.reset();
+    released = true;
+    worker.join();
+
+    ThreadSlots<Counter> fresh;
+    fresh.local(make_counter);
+    CHECK_EQ(fresh.size(), 1u);
+}
+
+// An elastic pool that keeps growing and shrinking must not leave a shard
+// or ring behind for every worker it ever started
+void test_pool_churn_keeps_slots_bounded() {
+    char path[] = "/tmp/cppweb_thread_slots_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+
+    MetricsRegistry metrics;
+    Tracer tracer(64);
+    tracer.set_sample_rate(1.0);
+    AccessLogConfig config;
+    config.path = path;
+    config.ring_capacity = 16;
+    AccessLog log(config);
+
+    PoolOptions options;
+    options.min_threads = 1;
+    options.max_threads = 4;
+    options.target_queue_wait = std::chrono::milliseconds(1);
+    options.idle_timeout = std::chrono::milliseconds(10);
+
+    uint64_t started = 0;
+    {
+        ThreadPool pool(options);
+        std::atomic<int> finished{0};
+        const int cycles = 8;
+        const int tasks = 16;
+
+        for (int cycle = 0; cycle < cycles; ++cycle) {
+            for (int i = 0; i < tasks; ++i) {
+                pool.enqueue([&] {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    metrics.record_queue_wait(1000);
+                    tracer.record(tracer.sample(), TracePhase::Handler, 1, 2, "GET /");
+                    AccessRecord record;
+                    record.status_code = 200;
+                    log.log(record);
+                    finished++;
+                });
+            }
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while ((finished < (cycle + 1) * tasks || pool.get_stats().threads > options.min_threads) &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            // Retired workers are counted out just before they exit
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        CHECK_EQ(finished.load(), cycles * tasks);
+        started = pool.get_stats().threads_started;
+    }
+
+    // The pool did churn, yet every owner stayed within its peak thread count
+    CHECK(started > options.max_threads);
+    CHECK(metrics.shard_count() <= options.max_threads);
+    CHECK(tracer.ring_count() <= options.max_threads);
+    CHECK(log.ring_count() <= options.max_threads);
+    CHECK_EQ(metrics.snapshot().queue_wait.count(), 8u * 16u);
+
+    ::unlink(path);
+}
+
+} // namespace
+
+int main() {
+    test_exited_thread_slot_is_reused();
+    test_concurrent_threads_get_own_slots();
+    test_thread_outlives_owner();
+    test_pool_churn_keeps_slots_bounded();
+    return cppweb::test::test_result();
+}
@@ -0,0 +1,102 @@
+#include "../include/cppweb/net/transport.hpp"
+#include "../include/cppweb/utils/mapped_file.hpp"
+#include "test_support.hpp"
+
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+using namespace cppweb;
+using cppweb::net::FileSource;
+
+namespace {
+
+// Collects what would go to the socket; like TLS, it copies buffers in user space
+class RecordingTransport : public net::Transport {
+public:
+    explicit RecordingTransport(bool mapped_ok) : Transport(-1), mapped_ok(mapped_ok) {}
+
+    std::string sent;
+
+    ssize_t read(void*, size_t) override { return 0; }
+    ssize_t write(const void* data, size_t len) override {
+        sent.append(static_cast<const char*>(data), len);
+        return static_cast<ssize_t>(len);
+    }
+    ssize_t send_file(int file_fd, off_t offset, size_t count) override {
+        return net::send_file_buffered(*this, file_fd, offset, count);
+    }
+    bool writes_mapped_memory() const override { return mapped_ok; }
+
+private:
+    bool mapped_ok;
+};
+
+std::string temp_file(const std::string& contents) {
+    char path[] = "/tmp/cppweb_transport_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+}
+
+// File-backed buffers are read from the file, in order with the others; their
+// memory is never touched, so it may even be null here
+void test_file_sources_are_read_from_the_file() {
+    std::string path = temp_file("0123456789abcdefghij");
+    auto file = utils::MappedFile::open(path);
+
+    std::string head = "HEAD|";
+    std::string tail = "|TAIL";
+    iovec iov[] = {{&head[0], head.size()}, {nullptr, 5}, {&tail[0], tail.size()}, {nullptr, 3}};
+    FileSource files[] = {{}, {file->fd(), 10}, {}, {file->fd(), 0}};
+
+    RecordingTransport transport(false);
+    CHECK(transport.writev_all(iov, files, 4));
+    CHECK_EQ(transport.sent, "HEAD|abcde|TAIL012");
+    ::unlink(path.c_str());
+}
+
+// A file shorter than its buffer ends the send with an error instead of a fault
+void test_truncated_file_fails() {
+    std::string path = temp_file(std::string(100, 'f'));
+    auto file = utils::MappedFile::open(path);
+    CHECK(::truncate(path.c_str(), 10) == 0);
+
+    std::string head = "HEAD|";
+    iovec iov[] = {{&head[0], head.size()}, {nullptr, 100}};
+    FileSource files[] = {{}, {file->fd(), 0}};
+
+    RecordingTransport transport(false);
+    CHECK(!transport.writev_all(iov, files, 2));
+    CHECK_EQ(transport.sent, "HEAD|" + std::string(10, 'f'));
+    ::unlink(path.c_str());
+}
+
+// Transports that can write mapped memory get the buffers as they are
+void test_mapped_memory_written_directly() {
+    std::string path = temp_file("mapped");
+    auto file = utils::MappedFile::open(path);
+    BodySegment segment = file->segment(1, 4);
+    CHECK_EQ(segment.file_fd, file->fd());
+    CHECK_EQ(segment.file_offset, 1u);
+
+    iovec iov[] = {{const_cast<char*>(segment.data), segment.size}};
+    FileSource files[] = {{segment.file_fd, segment.file_offset}};
+    RecordingTransport transport(true);
+    CHECK(transport.writev_all(iov, files, 1));
+    CHECK_EQ(transport.sent, "appe");
+    ::unlink(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    test_file_sources_are_read_from_the_file();
+    test_truncated_file_fails();
+    test_mapped_memory_written_directly();
+    return cppweb::test::test_result();
+}